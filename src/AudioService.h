@@ -13,8 +13,14 @@
 #include <QtMultimedia>
 #include <QSharedPointer>
 #include <QIODevice>
+#include <QHash>
+#include <QNetworkInterface>
+#include <QUdpSocket>
 #include <memory>
+#include "InterfaceMonitor.h"
 #include "Message.h"
+#include "NetworkEngine.h"
+#include "UnicastFanout.h"
 
 /**
  * @brief AudioPlayer is responsible for playing audio data from remote audio source.
@@ -119,34 +125,143 @@ public:
     {
         connect(this, &AudioStreamer::audioDataProvided, this, &AudioStreamer::writeAudioDataBytes);
     }
+    /**
+     * @brief Streams to the group on every interface reported by monitor.
+     *
+     * Each interface gets its own send-only socket with the interface set as the outgoing
+     * multicast interface. Interface changes are applied while streaming, so the next packet
+     * already goes out on the new set of interfaces. With an engine the sockets belong to it
+     * and packets are sent without the Qt event loop; the engine must outlive the streamer.
+     */
+    explicit AudioStreamer(QHostAddress multicastGroupAddress, quint16 multicastPort, InterfaceMonitor* monitor, QObject* parent = nullptr, NetworkEngine* engine = nullptr)
+        : QObject(parent)
+        , multicastGroupAddress(multicastGroupAddress)
+        , multicastPort(multicastPort)
+        , engine(engine)
+    {
+        connect(this, &AudioStreamer::audioDataProvided, this, &AudioStreamer::writeAudioDataBytes);
+        if (monitor) {
+            setInterfaces(monitor->interfaces());
+            connect(monitor, &InterfaceMonitor::interfacesChanged, this, &AudioStreamer::setInterfaces);
+        }
+    }
     virtual ~AudioStreamer() {
         if (socket) {
             socket->disconnectFromHost();
         }
+        for (const auto& interfaceSocket : interfaceSockets) {
+            closeInterfaceSocket(interfaceSocket);
+        }
     }
     void receiveAudioData(const QByteArray& audioData) {
         QByteArray audioStream;
         QDataStream stream(&audioStream, QIODevice::WriteOnly);
         stream << audioData;
-        if (socket->isOpen()) {
-            socket->write(audioStream);
-        }
+        writeAudioDataBytes(audioStream);
     }
     QSharedPointer<QAbstractSocket> getSocket() const {
         return socket;
     }
+    /** @brief Names of the interfaces currently streamed to. */
+    QList<QString> getInterfaceNames() const {
+        return interfaceSockets.keys();
+    }
+    /** @brief Also relays every packet to the unicast subscribers of fanout, null to stop. */
+    void setFanout(const QSharedPointer<UnicastFanout>& fanout) {
+        this->fanout = fanout;
+    }
 public slots:
-    void writeAudioDataBytes(QByteArray& audioData) {
-        if (socket->isOpen()) {
+    void writeAudioDataBytes(const QByteArray& audioData) {
+        if (fanout) {
+            fanout->send(audioData.constData(), static_cast<size_t>(audioData.size()));
+        }
+        if (!interfaceSockets.isEmpty()) {
+            for (const auto& interfaceSocket : interfaceSockets) {
+                if (interfaceSocket.engineSocket >= 0) {
+                    engine->send(interfaceSocket.engineSocket, audioData.constData(), static_cast<size_t>(audioData.size()),
+                                 multicastGroupAddress, multicastPort);
+                } else {
+                    interfaceSocket.socket->writeDatagram(audioData, multicastGroupAddress, multicastPort);
+                }
+            }
+        } else if (socket && socket->isOpen()) {
             socket->write(audioData);
         }
     }
+    /**
+     * @brief Drops the sockets of interfaces that are gone and opens one per new interface.
+     * An interface whose index or IPv4 addresses changed gets a new socket.
+     */
+    void setInterfaces(const QList<QNetworkInterface>& interfaces) {
+        QHash<QString, QNetworkInterface> wanted;
+        for (const QNetworkInterface& iface : interfaces) {
+            wanted.insert(iface.name(), iface);
+        }
+        for (auto it = interfaceSockets.begin(); it != interfaceSockets.end();) {
+            auto found = wanted.constFind(it.key());
+            if (found == wanted.constEnd() || found->index() != it->iface.index()
+                || found->addressEntries() != it->iface.addressEntries()) {
+                closeInterfaceSocket(*it);
+                it = interfaceSockets.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (const QNetworkInterface& iface : interfaces) {
+            if (interfaceSockets.contains(iface.name())) {
+                continue;
+            }
+            if (engine) {
+                // Send-only as below; the engine drops the odd stray datagram it receives
+                const int engineSocket = engine->openUdp(QHostAddress::AnyIPv4, 0,
+                    [](const char*, size_t, const QHostAddress&, quint16) {});
+                if (engineSocket < 0) {
+                    qWarning() << "AudioStreamer::setInterfaces - bind failed on" << iface.name();
+                    continue;
+                }
+                engine->setMulticastOptions(engineSocket, iface, 1, false);
+                interfaceSockets.insert(iface.name(), { nullptr, iface, engineSocket });
+                continue;
+            }
+            auto udpSocket = QSharedPointer<QUdpSocket>::create();
+            // Send-only: an ephemeral port and no group membership, so it never queues
+            // the stream it sends, nor the streams of other hosts
+            if (!udpSocket->bind(QHostAddress::AnyIPv4, 0)) {
+                qWarning() << "AudioStreamer::setInterfaces - bind failed on" << iface.name() << udpSocket->errorString();
+                continue;
+            }
+            udpSocket->setSocketOption(QAbstractSocket::MulticastTtlOption, 1); // Set TTL to 1 for local network
+            // Local listeners would otherwise get one copy per interface
+            udpSocket->setSocketOption(QAbstractSocket::MulticastLoopbackOption, false);
+            udpSocket->setMulticastInterface(iface);
+            interfaceSockets.insert(iface.name(), { udpSocket, iface, -1 });
+        }
+        emit interfacesChanged(interfaceSockets.keys());
+    }
 signals:
     void audioDataProvided(QByteArray& audioData);
+    void interfacesChanged(const QList<QString>& interfaceNames);
 private:
+    struct InterfaceSocket {
+        QSharedPointer<QUdpSocket> socket;
+        QNetworkInterface iface;
+        int engineSocket;   // -1 unless the socket belongs to engine
+    };
+    void closeInterfaceSocket(const InterfaceSocket& interfaceSocket) {
+        if (interfaceSocket.engineSocket >= 0) {
+            engine->closeSocket(interfaceSocket.engineSocket);
+        } else {
+            interfaceSocket.socket->close();
+        }
+    }
     QHostAddress multicastGroupAddress;
     quint16 multicastPort;
     QSharedPointer<QAbstractSocket> socket;
+    // One socket per interface in multi-interface mode, keyed by interface name
+    QHash<QString, InterfaceSocket> interfaceSockets;
+    // Relay mode subscribers, in addition to the multicast group
+    QSharedPointer<UnicastFanout> fanout;
+    NetworkEngine* engine = nullptr;
 };
 
 /**
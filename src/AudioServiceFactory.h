@@ -10,6 +10,8 @@
 #include <QUdpSocket>
 #include <memory>
 #include "AudioService.h"
+#include "InterfaceMonitor.h"
+#include "MappedAudioFile.h"
 #include "Message.h"
 
 class AudioPlayerFactory {
@@ -32,13 +34,18 @@ private:
 
 class AudioStreamerFactory {
 public:
-    explicit AudioStreamerFactory(QHostAddress multicastGroupAddress, quint16 multicastPort, QObject* parent = nullptr)
-        : multicastGroupAddress(multicastGroupAddress), multicastPort(multicastPort)
+    // With a monitor, streamers send on every usable interface and follow its changes, through
+    // engine if given; without one they use a single socket bound to any address.
+    explicit AudioStreamerFactory(QHostAddress multicastGroupAddress, quint16 multicastPort, QObject* parent = nullptr, InterfaceMonitor* monitor = nullptr, NetworkEngine* engine = nullptr)
+        : multicastGroupAddress(multicastGroupAddress), multicastPort(multicastPort), monitor(monitor), engine(engine)
     {}
 
     virtual ~AudioStreamerFactory() = default;
 
     std::unique_ptr<AudioStreamer> create() {
+        if (monitor) {
+            return std::make_unique<AudioStreamer>(multicastGroupAddress, multicastPort, monitor, nullptr, engine);
+        }
         QSharedPointer<QUdpSocket> socket = QSharedPointer<QUdpSocket>::create();
         socket->setSocketOption(QAbstractSocket::MulticastTtlOption, 1); // Set TTL to 1 for local network
         socket->setSocketOption(QAbstractSocket::MulticastLoopbackOption, true); // Enable loopback for testing
@@ -50,6 +57,8 @@ public:
 private:
     QHostAddress multicastGroupAddress;
     quint16 multicastPort;
+    InterfaceMonitor* monitor;
+    NetworkEngine* engine;
 };
 
 class AudioCaptureFactory {
@@ -67,6 +76,29 @@ private:
     QAudioFormat format;
 };
 
+// Serves a local WAV or raw PCM file from a shared memory mapping.
+// Any number of sources created for the same path share one mapping.
+class FileAudioSourceFactory {
+public:
+    explicit FileAudioSourceFactory(QString filePath, int packetMs = 20, QAudioFormat rawFormat = QAudioFormat())
+        : filePath(filePath), packetMs(packetMs), rawFormat(rawFormat)
+    {}
+
+    std::unique_ptr<FileAudioSource> create(bool loop = false)
+    {
+        auto file = MappedAudioFile::open(filePath, rawFormat);
+        if (!file) {
+            return nullptr;
+        }
+        return std::make_unique<FileAudioSource>(file, packetMs, loop);
+    }
+
+private:
+    QString filePath;
+    int packetMs;
+    QAudioFormat rawFormat;
+};
+
 class AudioServiceFactory {
 public:
     explicit AudioServiceFactory(QSharedPointer<AudioPlayer> player, QSharedPointer<AudioStreamer> streamer, QObject* parent = nullptr)
@@ -77,6 +109,8 @@ public:
         return std::make_unique<AudioService>(player, streamer);
     }
 
+    QSharedPointer<AudioStreamer> getStreamer() const { return streamer; }
+
 private:
     QSharedPointer<AudioPlayer> player;
     QSharedPointer<AudioStreamer> streamer;
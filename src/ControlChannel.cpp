@@ -0,0 +1,189 @@
+// ControlChannel.cpp
+#include <QDebug>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <cstdlib>
+#include "ControlChannel.h"
+
+ControlChannel::ControlChannel(QObject* parent)
+    : QObject(parent)
+    // Random start, so a restarted peer does not replay responses cached for our previous run
+    , nextRequestId(QRandomGenerator::global()->generate())
+{
+    clock.start();
+    retransmitTimer.setSingleShot(true);
+    connect(&retransmitTimer, &QTimer::timeout, this, &ControlChannel::retransmit);
+}
+
+quint32 ControlChannel::sendRequest(QSharedPointer<Message> request, const QHostAddress& peer, quint16 port)
+{
+    if (++nextRequestId == 0) {
+        nextRequestId = 1; // 0 means no request ID
+    }
+    request->setRequestId(nextRequestId);
+    Request& entry = requests[nextRequestId];
+    entry.bytes = *serial.write(request);
+    entry.peer = peer;
+    entry.port = port;
+    waiting.push_back(nextRequestId);
+    sendWaiting();
+    scheduleRetransmit();
+    return nextRequestId;
+}
+
+void ControlChannel::sendResponse(quint32 requestId, QSharedPointer<Message> response, const QHostAddress& peer, quint16 port)
+{
+    response->setRequestId(requestId);
+    const QByteArray bytes = *serial.write(response);
+    const ResponseKey key{ peer, port, requestId };
+    pruneResponses();
+    if (!responses.contains(key)) {
+        responseExpiry.emplace_back(key, clock.elapsed() + responseCacheMs);
+    }
+    responses.insert(key, bytes);
+    emit datagramReady(bytes, peer, port);
+}
+
+void ControlChannel::cancelRequests(const QHostAddress& peer)
+{
+    for (auto it = requests.begin(); it != requests.end();) {
+        if (it->peer == peer) {
+            if (it->attempts > 0) {
+                inFlight--;
+            }
+            it = requests.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    // Waiting IDs of cancelled requests are skipped by sendWaiting
+    sendWaiting();
+    scheduleRetransmit();
+}
+
+bool ControlChannel::handleDatagram(const QByteArray& data, const QHostAddress& sender, quint16 senderPort)
+{
+    auto message = serial.read(QSharedPointer<QByteArray>::create(data));
+    if (!message || !isControlMessage(message->getType())) {
+        return false;
+    }
+    const quint32 requestId = message->getRequestId();
+    if (isControlRequest(message->getType())) {
+        pruneResponses();
+        auto cached = responses.constFind(ResponseKey{ sender, senderPort, requestId });
+        if (cached != responses.cend()) {
+            // Our response was lost, the request is not news
+            emit datagramReady(*cached, sender, senderPort);
+            return true;
+        }
+        emit requestReceived(message, sender, senderPort);
+        return true;
+    }
+
+    auto it = requests.find(requestId);
+    if (it == requests.end() || it->attempts == 0) {
+        return true; // answer to a retransmission we already have the answer of
+    }
+    // Request IDs are only unique per requester, a response from anyone else is not ours
+    if (!it->peer.isEqual(sender, QHostAddress::ConvertV4MappedToIPv4)) {
+        return true;
+    }
+    // Karn's algorithm: only a request sent once gives an unambiguous round trip time
+    if (it->attempts == 1) {
+        updateRtt(clock.elapsed() - it->sentMs);
+    }
+    requests.erase(it);
+    inFlight--;
+    sendWaiting();
+    scheduleRetransmit();
+    emit responseReceived(requestId, message, sender);
+    return true;
+}
+
+void ControlChannel::retransmit()
+{
+    const qint64 now = clock.elapsed();
+    std::vector<std::pair<quint32, QHostAddress>> failed;
+    for (auto it = requests.begin(); it != requests.end();) {
+        if (it->attempts == 0 || it->deadlineMs > now) {
+            ++it;
+            continue;
+        }
+        if (it->attempts >= maxAttempts) {
+            failed.emplace_back(it.key(), it->peer);
+            inFlight--;
+            it = requests.erase(it);
+            continue;
+        }
+        transmit(it.key(), *it);
+        ++it;
+    }
+    sendWaiting();
+    scheduleRetransmit();
+    for (const auto& [requestId, peer] : failed) {
+        qWarning() << "ControlChannel - Request" << requestId << "to" << peer << "got no response";
+        emit requestFailed(requestId, peer);
+    }
+}
+
+void ControlChannel::transmit(quint32 requestId, Request& request)
+{
+    if (request.attempts == 0) {
+        inFlight++;
+    }
+    request.attempts++;
+    request.sentMs = clock.elapsed();
+    // Exponential backoff from the current estimate
+    const int timeoutMs = std::min(rtoMs << (request.attempts - 1), maxRtoMs << 2);
+    request.deadlineMs = request.sentMs + timeoutMs;
+    emit datagramReady(request.bytes, request.peer, request.port);
+}
+
+void ControlChannel::sendWaiting()
+{
+    while (inFlight < maxInFlight && !waiting.empty()) {
+        const quint32 requestId = waiting.front();
+        waiting.pop_front();
+        auto it = requests.find(requestId);
+        if (it != requests.end() && it->attempts == 0) {
+            transmit(requestId, *it);
+        }
+    }
+}
+
+void ControlChannel::updateRtt(qint64 sampleMs)
+{
+    const int sample = static_cast<int>(std::min<qint64>(sampleMs, maxRtoMs));
+    if (srttMs < 0) {
+        srttMs = sample;
+        rttvarMs = sample / 2;
+    } else {
+        rttvarMs = (3 * rttvarMs + std::abs(srttMs - sample)) / 4;
+        srttMs = (7 * srttMs + sample) / 8;
+    }
+    rtoMs = std::clamp(srttMs + std::max(1, 4 * rttvarMs), minRtoMs, maxRtoMs);
+}
+
+void ControlChannel::scheduleRetransmit()
+{
+    qint64 earliest = -1;
+    for (const Request& request : std::as_const(requests)) {
+        if (request.attempts > 0 && (earliest < 0 || request.deadlineMs < earliest)) {
+            earliest = request.deadlineMs;
+        }
+    }
+    if (earliest < 0) {
+        retransmitTimer.stop();
+        return;
+    }
+    retransmitTimer.start(static_cast<int>(std::max<qint64>(0, earliest - clock.elapsed())));
+}
+
+void ControlChannel::pruneResponses()
+{
+    const qint64 now = clock.elapsed();
+    while (!responseExpiry.empty() && responseExpiry.front().second <= now) {
+        responses.remove(responseExpiry.front().first);
+        responseExpiry.pop_front();
+    }
+}
@@ -0,0 +1,112 @@
+// ControlChannel.h
+#ifndef CONTROLCHANNEL_H
+#define CONTROLCHANNEL_H
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QSharedPointer>
+#include <QTimer>
+#include <deque>
+#include "Message.h"
+
+/**
+ * @brief Request/response exchange of control messages over UDP, with retransmission.
+ *
+ * Every request gets a request ID that its response echoes, so responses are matched to
+ * requests whatever order they come back in. Requests are pipelined: up to maxInFlight are
+ * outstanding at once, across every peer, and the rest wait in order. A request without a
+ * response is resent after the retransmission timeout, which is estimated from response times
+ * as TCP does (RFC 6298) and doubles with every retry; after maxAttempts it fails.
+ *
+ * The responder side keeps the responses it sent for responseCacheMs. A retransmitted request
+ * gets the same response again instead of being handled twice, so requests like
+ * StartAudioStreamRequest need not be idempotent.
+ *
+ * Datagrams go out through datagramReady; incoming ones are fed to handleDatagram.
+ */
+class ControlChannel : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int maxInFlight = 256;
+    static constexpr int maxAttempts = 6;
+
+    explicit ControlChannel(QObject* parent = nullptr);
+    virtual ~ControlChannel() = default;
+
+    /** @brief Queues request to peer and assigns its request ID.
+     * @return The request ID, reported again by responseReceived or requestFailed. */
+    quint32 sendRequest(QSharedPointer<Message> request, const QHostAddress& peer, quint16 port);
+    /** @brief Answers the request with requestId received from peer, and remembers the answer for retransmissions. */
+    void sendResponse(quint32 requestId, QSharedPointer<Message> response, const QHostAddress& peer, quint16 port);
+    /** @brief Drops every request to peer, pending or waiting, without reporting them. */
+    void cancelRequests(const QHostAddress& peer);
+
+    /** @return False if data is not a control message. */
+    bool handleDatagram(const QByteArray& data, const QHostAddress& sender, quint16 senderPort);
+
+    int pendingRequests() const { return static_cast<int>(requests.size()); }
+    int retransmitTimeoutMs() const { return rtoMs; }
+
+signals:
+    void datagramReady(QByteArray data, QHostAddress receiver, quint16 receiverPort);
+    /** @brief A new request, to be answered with sendResponse. */
+    void requestReceived(QSharedPointer<Message> request, QHostAddress sender, quint16 senderPort);
+    void responseReceived(quint32 requestId, QSharedPointer<Message> response, QHostAddress sender);
+    void requestFailed(quint32 requestId, QHostAddress peer);
+
+private slots:
+    void retransmit();
+
+private:
+    struct Request {
+        QByteArray bytes;
+        QHostAddress peer;
+        quint16 port = 0;
+        int attempts = 0;   // 0 while waiting for a free in-flight slot
+        qint64 sentMs = 0;
+        qint64 deadlineMs = 0;
+    };
+    struct ResponseKey {
+        QHostAddress peer;
+        quint16 port;
+        quint32 requestId;
+        bool operator==(const ResponseKey& other) const {
+            return requestId == other.requestId && port == other.port && peer == other.peer;
+        }
+    };
+    friend size_t qHash(const ResponseKey& key, size_t seed) {
+        return qHashMulti(seed, key.peer, key.port, key.requestId);
+    }
+
+    void transmit(quint32 requestId, Request& request);
+    void sendWaiting();
+    void updateRtt(qint64 sampleMs);
+    void scheduleRetransmit();
+    void pruneResponses();
+
+    static constexpr int initialRtoMs = 500;
+    static constexpr int minRtoMs = 50;
+    static constexpr int maxRtoMs = 2000;
+    // Longer than a requester keeps retransmitting
+    static constexpr int responseCacheMs = 30000;
+
+    MessageSerial serial;
+    QElapsedTimer clock;
+    QTimer retransmitTimer;
+    quint32 nextRequestId;
+    QHash<quint32, Request> requests;
+    std::deque<quint32> waiting;
+    int inFlight = 0;
+    // Smoothed round trip time and its variation, -1 until the first sample
+    int srttMs = -1;
+    int rttvarMs = 0;
+    int rtoMs = initialRtoMs;
+    QHash<ResponseKey, QByteArray> responses;
+    // Cached responses in the order they expire
+    std::deque<std::pair<ResponseKey, qint64>> responseExpiry;
+};
+
+#endif // CONTROLCHANNEL_H
@@ -0,0 +1,230 @@
+// DiscoveryEngine.cpp
+#include <QDebug>
+#include <QRandomGenerator>
+#include <algorithm>
+#include "DiscoveryEngine.h"
+
+DiscoveryEngine::DiscoveryEngine(SsrcId localSsrcId, std::vector<ServiceType> svcAnnounces, quint16 port, QObject* parent, NetworkEngine* engine)
+    : QObject(parent)
+    , localSsrcId(localSsrcId)
+    , svcAnnounces(svcAnnounces)
+    , port(port)
+    , engine(engine)
+{
+    queryTimer.setSingleShot(true);
+    responseTimer.setSingleShot(true);
+    connect(&queryTimer, &QTimer::timeout, this, &DiscoveryEngine::sendQuery);
+    connect(&responseTimer, &QTimer::timeout, this, &DiscoveryEngine::sendResponse);
+    connect(&socket, &QUdpSocket::readyRead, this, &DiscoveryEngine::readDatagrams);
+}
+
+void DiscoveryEngine::start()
+{
+    if (active) {
+        return;
+    }
+    if (engine) {
+        // Runs on the engine thread: copy the datagram and hand it to ours
+        engineSocket = engine->openUdp(QHostAddress::AnyIPv4, port,
+            [this](const char* data, size_t size, const QHostAddress& sender, quint16) {
+                auto bytes = QSharedPointer<QByteArray>::create(data, static_cast<qsizetype>(size));
+                QMetaObject::invokeMethod(this, [this, bytes, sender]() {
+                    handleDatagram(bytes, sender);
+                }, Qt::QueuedConnection);
+            });
+        if (engineSocket < 0) {
+            qWarning() << "DiscoveryEngine - Failed to bind port" << port;
+            return;
+        }
+        engine->enableBroadcast(engineSocket);
+    } else if (socket.state() != QAbstractSocket::BoundState
+        && !socket.bind(QHostAddress::AnyIPv4, port, QUdpSocket::ReuseAddressHint | QUdpSocket::ShareAddress)) {
+        qWarning() << "DiscoveryEngine - Failed to bind port" << port << ":" << socket.errorString();
+        return;
+    }
+    active = true;
+    intervalMs = initialIntervalMs;
+    queryTimer.start(QRandomGenerator::global()->bounded(minResponseDelayMs, maxResponseDelayMs + 1));
+}
+
+void DiscoveryEngine::stop()
+{
+    if (!active) {
+        return;
+    }
+    active = false;
+    queryTimer.stop();
+    responseTimer.stop();
+    if (engineSocket >= 0) {
+        engine->closeSocket(engineSocket);
+        engineSocket = -1;
+    }
+    socket.close();
+}
+
+void DiscoveryEngine::forgetPeer(SsrcId ssrcId)
+{
+    knownPeers.remove(ssrcId);
+}
+
+void DiscoveryEngine::setServices(std::vector<ServiceType> services)
+{
+    svcAnnounces = std::move(services);
+    if (active) {
+        intervalMs = initialIntervalMs;
+        scheduleNextQuery();
+    }
+}
+
+void DiscoveryEngine::readDatagrams()
+{
+    while (socket.hasPendingDatagrams()) {
+        auto bytes = QSharedPointer<QByteArray>::create();
+        QHostAddress sender;
+        bytes->resize(int(socket.pendingDatagramSize()));
+        if (socket.readDatagram(bytes->data(), bytes->size(), &sender) < 0) {
+            continue;
+        }
+        handleDatagram(bytes, sender);
+    }
+}
+
+void DiscoveryEngine::handleDatagram(QSharedPointer<QByteArray> bytes, const QHostAddress& sender)
+{
+    if (!active) {
+        return; // queued by the engine before stop()
+    }
+    auto message = serial.read(bytes);
+    if (!message) {
+        return;
+    }
+    switch (message->getType()) {
+    case MessageType::PeerDiscoveryRequest:
+        if (auto request = message->getData().dynamicCast<PeerDiscoveryRequest>()) {
+            handleRequest(*request, sender);
+        }
+        break;
+    case MessageType::PeerDiscoveryResponse:
+        if (auto response = message->getData().dynamicCast<PeerDiscoveryResponse>()) {
+            handleResponse(*response, sender);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void DiscoveryEngine::handleRequest(const PeerDiscoveryRequest& request, const QHostAddress& sender)
+{
+    if (request.ssrcId == localSsrcId) {
+        return; // our own broadcast
+    }
+    learnPeer(request.ssrcId, request.svcAnnounces, sender);
+
+    // Our pending query is redundant if this one suppresses no answer we still need
+    const bool duplicate = std::all_of(request.knownAnswers.begin(), request.knownAnswers.end(), [this](SsrcId ssrcId) {
+        return ssrcId == localSsrcId || isFresh(ssrcId);
+    });
+    if (duplicate && queryTimer.isActive()) {
+        scheduleNextQuery();
+    }
+
+    if (std::find(request.knownAnswers.begin(), request.knownAnswers.end(), localSsrcId) != request.knownAnswers.end()) {
+        return;
+    }
+    if (responseTimer.isActive()) {
+        return; // the pending answer covers this query as well
+    }
+    int delayMs = QRandomGenerator::global()->bounded(minResponseDelayMs, maxResponseDelayMs + 1);
+    if (sinceResponse.isValid() && sinceResponse.elapsed() < minResponseSpacingMs) {
+        delayMs = std::max<int>(delayMs, minResponseSpacingMs - sinceResponse.elapsed());
+    }
+    responseTimer.start(delayMs);
+}
+
+void DiscoveryEngine::handleResponse(const PeerDiscoveryResponse& response, const QHostAddress& sender)
+{
+    if (response.ssrcId == localSsrcId) {
+        return;
+    }
+    learnPeer(response.ssrcId, {}, sender);
+}
+
+void DiscoveryEngine::learnPeer(SsrcId ssrcId, const std::vector<ServiceType>& services, const QHostAddress& address)
+{
+    auto it = knownPeers.find(ssrcId);
+    if (it != knownPeers.end()) {
+        it->address = address;
+        it->lastSeen.start();
+        emit peerSeen(ssrcId, address);
+        return;
+    }
+    KnownPeer& peer = knownPeers[ssrcId];
+    peer.address = address;
+    peer.lastSeen.start();
+    emit peerDiscovered(ssrcId, services, address);
+    emit peerSeen(ssrcId, address);
+    // The peer set changed, look again soon in case more peers are coming up
+    if (active && intervalMs > initialIntervalMs) {
+        intervalMs = initialIntervalMs;
+        scheduleNextQuery();
+    }
+}
+
+void DiscoveryEngine::sendQuery()
+{
+    if (!active) {
+        return;
+    }
+    std::vector<SsrcId> knownAnswers;
+    knownAnswers.reserve(std::min<qsizetype>(knownPeers.size(), PeerDiscoveryRequest::maxKnownAnswers));
+    for (auto it = knownPeers.cbegin(); it != knownPeers.cend() && knownAnswers.size() < PeerDiscoveryRequest::maxKnownAnswers; ++it) {
+        if (it->lastSeen.elapsed() < peerTtlMs / 2) {
+            knownAnswers.push_back(it.key());
+        }
+    }
+    auto request = QSharedPointer<PeerDiscoveryRequest>::create(localSsrcId, svcAnnounces, std::move(knownAnswers));
+    send(QSharedPointer<Message>::create(MessageType::PeerDiscoveryRequest, request.staticCast<IMessageData>()));
+    scheduleNextQuery();
+}
+
+void DiscoveryEngine::scheduleNextQuery()
+{
+    queryTimer.start(jittered(intervalMs, 20));
+    intervalMs = std::min(intervalMs * 2, maxIntervalMs);
+}
+
+void DiscoveryEngine::sendResponse()
+{
+    if (!active) {
+        return;
+    }
+    auto response = QSharedPointer<PeerDiscoveryResponse>::create(localSsrcId);
+    send(QSharedPointer<Message>::create(MessageType::PeerDiscoveryResponse, response.staticCast<IMessageData>()));
+    sinceResponse.start();
+}
+
+void DiscoveryEngine::send(QSharedPointer<Message> message)
+{
+    const auto bytes = serial.write(message);
+    if (engineSocket >= 0) {
+        if (!engine->send(engineSocket, bytes->constData(), static_cast<size_t>(bytes->size()), QHostAddress::Broadcast, port)) {
+            qWarning() << "DiscoveryEngine - Failed to send, engine queue or socket buffer full";
+        }
+        return;
+    }
+    if (socket.writeDatagram(*bytes, QHostAddress::Broadcast, port) < 0) {
+        qWarning() << "DiscoveryEngine - Failed to send:" << socket.errorString();
+    }
+}
+
+bool DiscoveryEngine::isFresh(SsrcId ssrcId) const
+{
+    auto it = knownPeers.constFind(ssrcId);
+    return it != knownPeers.cend() && it->lastSeen.elapsed() < peerTtlMs / 2;
+}
+
+int DiscoveryEngine::jittered(int ms, int maxPercent)
+{
+    return ms + QRandomGenerator::global()->bounded(ms * maxPercent / 100 + 1);
+}
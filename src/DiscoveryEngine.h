@@ -0,0 +1,99 @@
+// DiscoveryEngine.h
+#ifndef DISCOVERYENGINE_H
+#define DISCOVERYENGINE_H
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QTimer>
+#include <QUdpSocket>
+#include <vector>
+#include "Message.h"
+#include "NetworkEngine.h"
+
+/**
+ * @brief Finds peers on the local network, in the style of mDNS.
+ *
+ * Queries are PeerDiscoveryRequests broadcast on one persistent socket. The first one is delayed
+ * by a random 20-120 ms so instances started together do not send in lockstep; after that the
+ * interval doubles from 1 s up to 60 s (plus up to 20 % jitter) and falls back to 1 s whenever
+ * a new peer shows up. Traffic stays O(peers) per query:
+ * - Known answers: a query lists the SSRCs the sender heard from within half of peerTtlMs,
+ *   those peers stay silent; the others answer in time to be kept alive.
+ * - Duplicate question suppression: responses are broadcast, so a query seen from another peer
+ *   whose known answers we all know as well draws every answer ours would; we skip ours.
+ * - Duplicate answer suppression: a peer answers at most once per second and queries arriving
+ *   while its randomly delayed answer is pending are covered by that single answer.
+ *
+ * With a NetworkEngine the socket belongs to the engine thread, so queries are still received
+ * while the GUI thread is busy; the engine must be stopped before the DiscoveryEngine is destroyed.
+ */
+class DiscoveryEngine : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr quint16 defaultPort = 3103;
+    // A peer not heard from for this long is gone; must exceed twice the longest query interval
+    static constexpr int peerTtlMs = 180000;
+
+    explicit DiscoveryEngine(SsrcId localSsrcId, std::vector<ServiceType> svcAnnounces, quint16 port = defaultPort, QObject* parent = nullptr, NetworkEngine* engine = nullptr);
+    virtual ~DiscoveryEngine() = default;
+    void start();
+    void stop();
+    bool isActive() const { return active; }
+    /** @brief Forgets a peer, so the next query asks for it again. */
+    void forgetPeer(SsrcId ssrcId);
+    /** @brief Changes the services announced in our queries; the next query goes out soon. */
+    void setServices(std::vector<ServiceType> services);
+
+signals:
+    /** @brief Emitted the first time a peer is heard of, from either its query or its response. */
+    void peerDiscovered(SsrcId ssrcId, std::vector<ServiceType> svcAnnounces, QHostAddress address);
+    /** @brief Emitted for every query or response received from a peer, new or not. */
+    void peerSeen(SsrcId ssrcId, QHostAddress address);
+
+private slots:
+    void readDatagrams();
+    void sendQuery();
+    void sendResponse();
+
+private:
+    void handleDatagram(QSharedPointer<QByteArray> bytes, const QHostAddress& sender);
+    void handleRequest(const PeerDiscoveryRequest& request, const QHostAddress& sender);
+    void handleResponse(const PeerDiscoveryResponse& response, const QHostAddress& sender);
+    /** @brief Records a peer; a new one restarts the backoff. */
+    void learnPeer(SsrcId ssrcId, const std::vector<ServiceType>& svcAnnounces, const QHostAddress& address);
+    void scheduleNextQuery();
+    void send(QSharedPointer<Message> message);
+    /** @return True if the peer was heard from recently enough to be listed as known answer. */
+    bool isFresh(SsrcId ssrcId) const;
+    /** @return ms with up to maxPercent % added at random. */
+    static int jittered(int ms, int maxPercent);
+
+    static constexpr int initialIntervalMs = 1000;
+    static constexpr int maxIntervalMs = 60000;
+    static constexpr int minResponseDelayMs = 20;
+    static constexpr int maxResponseDelayMs = 120;
+    static constexpr int minResponseSpacingMs = 1000;
+
+    SsrcId localSsrcId;
+    std::vector<ServiceType> svcAnnounces;
+    quint16 port;
+    bool active = false;
+    QUdpSocket socket;
+    NetworkEngine* engine;
+    // Socket of engine, -1 while not active or without engine
+    int engineSocket = -1;
+    MessageSerial serial;
+    QTimer queryTimer;
+    QTimer responseTimer;
+    int intervalMs = initialIntervalMs;
+    QElapsedTimer sinceResponse;
+    struct KnownPeer {
+        QHostAddress address;
+        QElapsedTimer lastSeen;
+    };
+    QHash<SsrcId, KnownPeer> knownPeers;
+};
+
+#endif // DISCOVERYENGINE_H
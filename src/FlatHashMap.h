@@ -0,0 +1,113 @@
+// FlatHashMap.h
+#ifndef FLATHASHMAP_H
+#define FLATHASHMAP_H
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Open-addressing hash map from Key to a non-negative int, with linear probing.
+ *
+ * Keys and values sit in one flat array, so a lookup is a hash and usually a single
+ * cache line. Erasing shifts the following entries back instead of leaving tombstones,
+ * so lookups never slow down with churn. The capacity is a power of two and grows
+ * once the map is more than half full.
+ */
+template <typename Key, typename Hash>
+class FlatHashMap
+{
+public:
+    FlatHashMap() { slots.resize(16); }
+
+    /** @return Value stored for key, or -1. */
+    int find(const Key& key) const {
+        for (size_t i = slotOf(key);; i = (i + 1) & mask()) {
+            const Slot& slot = slots[i];
+            if (slot.value < 0) {
+                return -1;
+            }
+            if (slot.key == key) {
+                return slot.value;
+            }
+        }
+    }
+
+    /** @brief Inserts or replaces the value stored for key. value must be non-negative. */
+    void insert(const Key& key, int value) {
+        if ((count + 1) * 2 > slots.size()) {
+            grow();
+        }
+        for (size_t i = slotOf(key);; i = (i + 1) & mask()) {
+            Slot& slot = slots[i];
+            if (slot.value < 0) {
+                slot.key = key;
+                slot.value = value;
+                ++count;
+                return;
+            }
+            if (slot.key == key) {
+                slot.value = value;
+                return;
+            }
+        }
+    }
+
+    /** @return True if key was stored. */
+    bool erase(const Key& key) {
+        size_t i = slotOf(key);
+        while (true) {
+            if (slots[i].value < 0) {
+                return false;
+            }
+            if (slots[i].key == key) {
+                break;
+            }
+            i = (i + 1) & mask();
+        }
+        // Backward shift: move later entries of the probe sequence into the hole
+        size_t hole = i;
+        for (size_t j = (i + 1) & mask(); slots[j].value >= 0; j = (j + 1) & mask()) {
+            const size_t home = slotOf(slots[j].key);
+            // Entry j may move to the hole if its home slot is not in (hole, j]
+            if (((j - home) & mask()) >= ((j - hole) & mask())) {
+                slots[hole] = slots[j];
+                hole = j;
+            }
+        }
+        slots[hole] = Slot();
+        --count;
+        return true;
+    }
+
+    size_t size() const { return count; }
+
+    void clear() {
+        std::fill(slots.begin(), slots.end(), Slot());
+        count = 0;
+    }
+
+private:
+    struct Slot {
+        Key key{};
+        int value = -1;
+    };
+
+    size_t mask() const { return slots.size() - 1; }
+    size_t slotOf(const Key& key) const { return Hash()(key) & mask(); }
+
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        count = 0;
+        for (const Slot& slot : old) {
+            if (slot.value >= 0) {
+                insert(slot.key, slot.value);
+            }
+        }
+    }
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+};
+
+#endif // FLATHASHMAP_H
@@ -0,0 +1,109 @@
+// InterfaceMonitor.cpp
+#include <QDebug>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <unistd.h>
+#include "InterfaceMonitor.h"
+
+InterfaceMonitor::InterfaceMonitor(QObject* parent)
+    : QObject(parent)
+{
+    rescanTimer.setSingleShot(true);
+    rescanTimer.setInterval(0);
+    connect(&rescanTimer, &QTimer::timeout, this, &InterfaceMonitor::rescan);
+    usable = scan();
+
+    netlinkFd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (netlinkFd < 0) {
+        qWarning() << "InterfaceMonitor - Failed to create netlink socket:" << strerror(errno);
+        return;
+    }
+    sockaddr_nl local;
+    std::memset(&local, 0, sizeof(local));
+    local.nl_family = AF_NETLINK;
+    local.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR;
+    if (bind(netlinkFd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0) {
+        qWarning() << "InterfaceMonitor - Failed to bind netlink socket:" << strerror(errno);
+        close(netlinkFd);
+        netlinkFd = -1;
+        return;
+    }
+    notifier = new QSocketNotifier(netlinkFd, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &InterfaceMonitor::readNetlink);
+}
+
+InterfaceMonitor::~InterfaceMonitor()
+{
+    delete notifier;
+    if (netlinkFd >= 0) {
+        close(netlinkFd);
+    }
+}
+
+void InterfaceMonitor::readNetlink()
+{
+    // The content does not matter, every message means the interface list may have changed;
+    // on ENOBUFS messages were lost, which a full rescan covers as well
+    char buf[8192];
+    while (true) {
+        const ssize_t size = recv(netlinkFd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (size > 0 || (size < 0 && (errno == EINTR || errno == ENOBUFS))) {
+            continue;
+        }
+        break;
+    }
+    rescanTimer.start();
+}
+
+void InterfaceMonitor::rescan()
+{
+    QList<QNetworkInterface> current = scan();
+    if (sameInterfaces(current, usable)) {
+        return;
+    }
+    usable = current;
+    emit interfacesChanged(usable);
+}
+
+QList<QNetworkInterface> InterfaceMonitor::scan()
+{
+    QList<QNetworkInterface> result;
+    const auto required = QNetworkInterface::IsUp | QNetworkInterface::IsRunning | QNetworkInterface::CanMulticast;
+    for (const QNetworkInterface& iface : QNetworkInterface::allInterfaces()) {
+        if ((iface.flags() & required) != required || (iface.flags() & QNetworkInterface::IsLoopBack)) {
+            continue;
+        }
+        for (const QNetworkAddressEntry& entry : iface.addressEntries()) {
+            if (entry.ip().protocol() == QAbstractSocket::IPv4Protocol) {
+                result.append(iface);
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+bool InterfaceMonitor::sameInterfaces(const QList<QNetworkInterface>& a, const QList<QNetworkInterface>& b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    auto ipv4 = [](const QNetworkInterface& iface) {
+        QList<QHostAddress> addresses;
+        for (const QNetworkAddressEntry& entry : iface.addressEntries()) {
+            if (entry.ip().protocol() == QAbstractSocket::IPv4Protocol) {
+                addresses.append(entry.ip());
+            }
+        }
+        return addresses;
+    };
+    for (int i = 0; i < a.size(); ++i) {
+        if (a[i].index() != b[i].index() || a[i].name() != b[i].name() || ipv4(a[i]) != ipv4(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
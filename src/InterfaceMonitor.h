@@ -0,0 +1,47 @@
+// InterfaceMonitor.h
+#ifndef INTERFACEMONITOR_H
+#define INTERFACEMONITOR_H
+#include <QObject>
+#include <QList>
+#include <QNetworkInterface>
+#include <QSocketNotifier>
+#include <QTimer>
+
+/**
+ * @brief Keeps the list of interfaces usable for IPv4 multicast up to date.
+ *
+ * Subscribes to the same rtnetlink groups as ipmon (links and IPv4 addresses) and
+ * rescans QNetworkInterface once per burst of messages, so a change is reported in
+ * the next event loop iteration instead of after a polling interval. An interface is
+ * usable when it is up, running, multicast capable, not loopback and has an IPv4 address.
+ */
+class InterfaceMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit InterfaceMonitor(QObject* parent = nullptr);
+    virtual ~InterfaceMonitor();
+    /** @brief Interfaces usable for multicast, as of the last scan. */
+    const QList<QNetworkInterface>& interfaces() const { return usable; }
+
+signals:
+    /** @brief Emitted whenever an interface became usable or unusable or its IPv4 addresses changed. */
+    void interfacesChanged(const QList<QNetworkInterface>& interfaces);
+
+private slots:
+    void readNetlink();
+    void rescan();
+
+private:
+    static QList<QNetworkInterface> scan();
+    /** @brief Compares interface names and their IPv4 addresses. */
+    static bool sameInterfaces(const QList<QNetworkInterface>& a, const QList<QNetworkInterface>& b);
+
+    int netlinkFd = -1;
+    QSocketNotifier* notifier = nullptr;
+    // Zero-interval single shot, collapses one burst of netlink messages into one scan
+    QTimer rescanTimer;
+    QList<QNetworkInterface> usable;
+};
+
+#endif // INTERFACEMONITOR_H
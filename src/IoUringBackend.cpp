@@ -0,0 +1,283 @@
+// IoUringBackend.cpp
+#include <QDebug>
+#include <QMutexLocker>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include "IoUringBackend.h"
+
+namespace {
+// Multishot recvmsg arrived in 6.0, provided buffer rings in 5.19
+bool kernelSupportsMultishotRecv()
+{
+    utsname name;
+    int major = 0;
+    if (uname(&name) != 0 || std::sscanf(name.release, "%d.", &major) != 1) {
+        return false;
+    }
+    return major >= 6;
+}
+}
+
+std::unique_ptr<IoUringBackend> IoUringBackend::create(int wakeFd)
+{
+    if (!kernelSupportsMultishotRecv()) {
+        qWarning() << "IoUringBackend - Kernel too old for multishot receive";
+        return nullptr;
+    }
+    std::unique_ptr<IoUringBackend> backend(new IoUringBackend(wakeFd));
+    if (!backend->init()) {
+        return nullptr;
+    }
+    return backend;
+}
+
+bool IoUringBackend::init()
+{
+    io_uring_params params{};
+    params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    int ret = io_uring_queue_init_params(ringEntries, &ring, &params);
+    if (ret < 0) {
+        // Flags unknown to kernels before 5.18/5.19
+        params = io_uring_params{};
+        ret = io_uring_queue_init_params(ringEntries, &ring, &params);
+    }
+    if (ret < 0) {
+        qWarning() << "IoUringBackend - io_uring_queue_init failed:" << strerror(-ret);
+        return false;
+    }
+    ringReady = true;
+
+    bufRing = io_uring_setup_buf_ring(&ring, recvBufferCount, recvBufferGroup, 0, &ret);
+    if (!bufRing) {
+        qWarning() << "IoUringBackend - io_uring_setup_buf_ring failed:" << strerror(-ret);
+        return false;
+    }
+    recvBuffers.resize(size_t(recvBufferCount) * recvBufferSize);
+    const int mask = io_uring_buf_ring_mask(recvBufferCount);
+    for (unsigned i = 0; i < recvBufferCount; i++) {
+        io_uring_buf_ring_add(bufRing, recvBuffers.data() + size_t(i) * recvBufferSize, recvBufferSize, i, mask, i);
+    }
+    io_uring_buf_ring_advance(bufRing, recvBufferCount);
+
+    recvMsg.msg_namelen = sizeof(sockaddr_storage);
+
+    sendSlots.resize(sendSlotCount);
+    sendBuffers.resize(size_t(sendSlotCount) * datagramSize);
+    freeSlots.reserve(sendSlotCount);
+    queuedSlots.reserve(sendSlotCount);
+    for (int i = sendSlotCount - 1; i >= 0; i--) {
+        freeSlots.push_back(i);
+    }
+    return true;
+}
+
+IoUringBackend::~IoUringBackend()
+{
+    for (int fd : closing) {
+        close(fd);
+    }
+    if (bufRing) {
+        io_uring_free_buf_ring(&ring, bufRing, recvBufferCount, recvBufferGroup);
+    }
+    if (ringReady) {
+        io_uring_queue_exit(&ring);
+    }
+}
+
+io_uring_sqe* IoUringBackend::sqe()
+{
+    io_uring_sqe* entry = io_uring_get_sqe(&ring);
+    if (!entry) {
+        // Submission queue full, hand what is there to the kernel
+        io_uring_submit(&ring);
+        entry = io_uring_get_sqe(&ring);
+    }
+    return entry;
+}
+
+void IoUringBackend::armWake()
+{
+    if (io_uring_sqe* entry = sqe()) {
+        io_uring_prep_poll_multishot(entry, wakeFd, POLLIN);
+        io_uring_sqe_set_data64(entry, userData(WakeTag, 0));
+    }
+}
+
+void IoUringBackend::armRecv(int fd)
+{
+    if (io_uring_sqe* entry = sqe()) {
+        io_uring_prep_recvmsg_multishot(entry, fd, &recvMsg, 0);
+        entry->flags |= IOSQE_BUFFER_SELECT;
+        entry->buf_group = recvBufferGroup;
+        io_uring_sqe_set_data64(entry, userData(RecvTag, uint32_t(fd)));
+    }
+}
+
+void IoUringBackend::addSocket(int fd, const NetworkEngine::ReceiveHandler* handler)
+{
+    sockets[fd] = handler;
+    armRecv(fd);
+}
+
+void IoUringBackend::removeSocket(int fd)
+{
+    if (sockets.erase(fd) == 0) {
+        return;
+    }
+    closing.insert(fd);
+    if (io_uring_sqe* entry = sqe()) {
+        io_uring_prep_cancel64(entry, userData(RecvTag, uint32_t(fd)), 0);
+        io_uring_sqe_set_data64(entry, userData(CancelTag, uint32_t(fd)));
+    }
+}
+
+bool IoUringBackend::queueSend(int fd, const char* data, size_t size, const sockaddr_storage& receiver, socklen_t receiverLength)
+{
+    if (size > size_t(datagramSize)) {
+        return false;
+    }
+    bool wasEmpty;
+    {
+        QMutexLocker locker(&sendMutex);
+        if (freeSlots.empty()) {
+            return false;
+        }
+        const int slot = freeSlots.back();
+        freeSlots.pop_back();
+        SendSlot& s = sendSlots[slot];
+        char* buffer = sendBuffers.data() + size_t(slot) * datagramSize;
+        std::memcpy(buffer, data, size);
+        s.fd = fd;
+        s.receiver = receiver;
+        s.iov = { buffer, size };
+        s.msg = msghdr{};
+        s.msg.msg_name = &s.receiver;
+        s.msg.msg_namelen = receiverLength;
+        s.msg.msg_iov = &s.iov;
+        s.msg.msg_iovlen = 1;
+        wasEmpty = queuedSlots.empty();
+        queuedSlots.push_back(slot);
+    }
+    // The engine thread picks up the whole queue on one wakeup
+    if (wasEmpty) {
+        const uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            qWarning() << "IoUringBackend - Failed to wake engine thread:" << strerror(errno);
+        }
+    }
+    return true;
+}
+
+void IoUringBackend::submitQueuedSends()
+{
+    std::vector<int> slots;
+    {
+        QMutexLocker locker(&sendMutex);
+        slots.swap(queuedSlots);
+        queuedSlots.reserve(sendSlotCount);
+    }
+    for (int slot : slots) {
+        io_uring_sqe* entry = sqe();
+        if (!entry) {
+            sendFailures.fetch_add(1, std::memory_order_relaxed);
+            releaseSlot(slot);
+            continue;
+        }
+        io_uring_prep_sendmsg(entry, sendSlots[slot].fd, &sendSlots[slot].msg, MSG_DONTWAIT);
+        io_uring_sqe_set_data64(entry, userData(SendTag, uint32_t(slot)));
+    }
+}
+
+void IoUringBackend::releaseSlot(int slot)
+{
+    QMutexLocker locker(&sendMutex);
+    freeSlots.push_back(slot);
+}
+
+void IoUringBackend::handleRecv(const io_uring_cqe* cqe)
+{
+    const int fd = int(uint32_t(io_uring_cqe_get_data64(cqe)));
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        const unsigned bufferId = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        char* buffer = recvBuffers.data() + size_t(bufferId) * recvBufferSize;
+        auto it = sockets.find(fd);
+        if (cqe->res > 0 && it != sockets.end()) {
+            io_uring_recvmsg_out* out = io_uring_recvmsg_validate(buffer, cqe->res, &recvMsg);
+            if (out && !(out->flags & MSG_TRUNC) && out->namelen <= sizeof(sockaddr_storage)) {
+                sockaddr_storage sender{};
+                std::memcpy(&sender, io_uring_recvmsg_name(out), out->namelen);
+                quint16 senderPort = 0;
+                const QHostAddress address = NetworkEngine::fromSockaddr(sender, &senderPort);
+                const char* payload = static_cast<const char*>(io_uring_recvmsg_payload(out, &recvMsg));
+                (*it->second)(payload, io_uring_recvmsg_payload_length(out, cqe->res, &recvMsg), address, senderPort);
+            }
+        }
+        // Back to the ring right away, the handler must not keep the pointer
+        io_uring_buf_ring_add(bufRing, buffer, recvBufferSize, bufferId, io_uring_buf_ring_mask(recvBufferCount), 0);
+        io_uring_buf_ring_advance(bufRing, 1);
+    }
+    if (cqe->flags & IORING_CQE_F_MORE) {
+        return;
+    }
+    // The multishot receive ended: cancelled, out of buffers (-ENOBUFS) or failed
+    if (sockets.count(fd)) {
+        if (cqe->res < 0 && cqe->res != -ENOBUFS) {
+            qWarning() << "IoUringBackend - Receive on" << fd << "failed:" << strerror(-cqe->res);
+        }
+        armRecv(fd);
+    } else if (closing.erase(fd)) {
+        close(fd);
+    }
+}
+
+void IoUringBackend::run(const std::atomic<bool>& stopping, const std::function<void()>& onWake)
+{
+    armWake();
+    while (!stopping.load(std::memory_order_acquire)) {
+        const int ret = io_uring_submit_and_wait(&ring, 1);
+        if (ret < 0 && ret != -EINTR && ret != -EBUSY) {
+            qWarning() << "IoUringBackend - io_uring_submit_and_wait failed:" << strerror(-ret);
+            break;
+        }
+        unsigned head;
+        unsigned count = 0;
+        io_uring_cqe* cqe;
+        bool woken = false;
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            count++;
+            const uint64_t data = io_uring_cqe_get_data64(cqe);
+            switch (Tag(data >> 32)) {
+            case WakeTag:
+                woken = true;
+                if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                    armWake();
+                }
+                break;
+            case RecvTag:
+                handleRecv(cqe);
+                break;
+            case SendTag:
+                if (cqe->res < 0) {
+                    sendFailures.fetch_add(1, std::memory_order_relaxed);
+                }
+                releaseSlot(int(uint32_t(data)));
+                break;
+            case CancelTag:
+                // Nothing left to cancel: the receive had already ended, close now
+                if (cqe->res == -ENOENT && closing.erase(int(uint32_t(data)))) {
+                    close(int(uint32_t(data)));
+                }
+                break;
+            }
+        }
+        io_uring_cq_advance(&ring, count);
+        if (woken) {
+            onWake();
+            submitQueuedSends();
+        }
+    }
+}
@@ -0,0 +1,95 @@
+// IoUringBackend.h
+#ifndef IOURINGBACKEND_H
+#define IOURINGBACKEND_H
+#include <QMutex>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <liburing.h>
+#include "NetworkEngine.h"
+
+/**
+ * @brief io_uring event loop behind NetworkEngine, only built with BLUELINE_WITH_IO_URING.
+ *
+ * Receiving: each socket has one multishot recvmsg armed against a provided buffer ring, so
+ * the kernel keeps completing datagrams into pooled buffers without any further syscall or
+ * re-arm; a buffer goes back to the ring as soon as its handler returned.
+ *
+ * Sending: send() copies the datagram into a slot of a preallocated pool and queues it; the
+ * engine thread turns all queued slots into sendmsg submissions and submits them with the
+ * wait for the next completion, one io_uring_enter for the whole batch.
+ *
+ * All methods but queueSend() run on the engine thread.
+ */
+class IoUringBackend
+{
+public:
+    /** @return Nullptr if the kernel lacks multishot receive or provided buffer rings (before 6.0). */
+    static std::unique_ptr<IoUringBackend> create(int wakeFd);
+    ~IoUringBackend();
+    IoUringBackend(const IoUringBackend&) = delete;
+    IoUringBackend& operator=(const IoUringBackend&) = delete;
+
+    /** @brief Starts delivering datagrams of fd to handler, which must stay valid until removeSocket(). */
+    void addSocket(int fd, const NetworkEngine::ReceiveHandler* handler);
+    /** @brief Stops delivering and closes fd once its pending receive is cancelled. */
+    void removeSocket(int fd);
+    /** @brief Thread safe. @return False if the datagram was dropped because no slot was free. */
+    bool queueSend(int fd, const char* data, size_t size, const sockaddr_storage& receiver, socklen_t receiverLength);
+    /** @brief Runs the loop until stopping is set; onWake runs whenever wakeFd was signalled. */
+    void run(const std::atomic<bool>& stopping, const std::function<void()>& onWake);
+
+    /** @brief Sends that failed after being queued. */
+    quint64 failedSends() const { return sendFailures.load(std::memory_order_relaxed); }
+
+private:
+    enum Tag : uint64_t { WakeTag = 1, RecvTag = 2, SendTag = 3, CancelTag = 4 };
+    static uint64_t userData(Tag tag, uint32_t value) { return (uint64_t(tag) << 32) | value; }
+
+    struct SendSlot {
+        int fd;
+        sockaddr_storage receiver;
+        msghdr msg;
+        iovec iov;
+    };
+
+    explicit IoUringBackend(int wakeFd) : wakeFd(wakeFd) {}
+    bool init();
+    io_uring_sqe* sqe();
+    void armWake();
+    void armRecv(int fd);
+    void submitQueuedSends();
+    void handleRecv(const io_uring_cqe* cqe);
+    void releaseSlot(int slot);
+
+    static constexpr unsigned ringEntries = 1024;
+    static constexpr unsigned recvBufferCount = 512; // power of two
+    static constexpr int recvBufferGroup = 0;
+    static constexpr int datagramSize = 2048;
+    static constexpr unsigned recvBufferSize = sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_storage) + datagramSize;
+    static constexpr int sendSlotCount = 256;
+
+    int wakeFd;
+    io_uring ring{};
+    bool ringReady = false;
+    io_uring_buf_ring* bufRing = nullptr;
+    std::vector<char> recvBuffers;
+    // Template for every multishot recvmsg: room for the sender address, no control data
+    msghdr recvMsg{};
+
+    std::unordered_map<int, const NetworkEngine::ReceiveHandler*> sockets;
+    // Removed sockets whose receive is still being cancelled
+    std::unordered_set<int> closing;
+
+    QMutex sendMutex;
+    std::vector<SendSlot> sendSlots;
+    std::vector<char> sendBuffers;
+    std::vector<int> freeSlots;
+    std::vector<int> queuedSlots;
+    std::atomic<quint64> sendFailures{0};
+};
+
+#endif // IOURINGBACKEND_H
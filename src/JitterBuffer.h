@@ -0,0 +1,164 @@
+// JitterBuffer.h
+#ifndef JITTERBUFFER_H
+#define JITTERBUFFER_H
+#include <QByteArray>
+#include <QtGlobal>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "RtpPacket.h"
+
+/**
+ * @brief Maps RTP timestamps of one stream onto the local monotonic clock.
+ *
+ * For every packet, offset = arrival time - media time. The smallest offset seen is the path
+ * with the least queuing, so playout = media time + smallest offset + delay absorbs jitter
+ * up to delay. The minimum is taken over two rolling windows, which lets the mapping follow
+ * drift between the sender's and our clock and forget a one-off fast packet.
+ */
+class RtpClockSync
+{
+public:
+    explicit RtpClockSync(int clockRate, qint64 windowUs = 5000000)
+        : clockRate(clockRate), windowUs(windowUs)
+    {}
+
+    /** @return Local time in us at which the packet with rtpTimestamp should be played. */
+    qint64 playoutUs(quint32 rtpTimestamp, qint64 arrivalUs, qint64 delayUs) {
+        if (!started) {
+            started = true;
+            extended = rtpTimestamp;
+            windowStartUs = arrivalUs;
+        } else {
+            extended += static_cast<qint32>(rtpTimestamp - lastTimestamp);
+        }
+        lastTimestamp = rtpTimestamp;
+        const qint64 mediaUs = extended * 1000000 / clockRate;
+        const qint64 offset = arrivalUs - mediaUs;
+        if (arrivalUs - windowStartUs > windowUs) {
+            previousMin = currentMin;
+            currentMin = offset;
+            windowStartUs = arrivalUs;
+        } else if (offset < currentMin) {
+            currentMin = offset;
+        }
+        return mediaUs + std::min(currentMin, previousMin) + delayUs;
+    }
+
+    void reset() { *this = RtpClockSync(clockRate, windowUs); }
+
+private:
+    int clockRate;
+    qint64 windowUs;
+    bool started = false;
+    quint32 lastTimestamp = 0;
+    qint64 extended = 0;
+    qint64 windowStartUs = 0;
+    qint64 currentMin = std::numeric_limits<qint64>::max();
+    qint64 previousMin = std::numeric_limits<qint64>::max();
+};
+
+/**
+ * @brief Reorders RTP packets of one stream by sequence number and releases them at their playout time.
+ *
+ * Slots are a ring indexed by sequence number, so inserting and releasing are O(1). Packets
+ * older than the one played last are late and dropped; a gap is skipped, and counted as lost,
+ * once a later packet is due.
+ */
+class JitterBuffer
+{
+public:
+    enum class InsertResult { Stored, Duplicate, Late };
+
+    explicit JitterBuffer(int capacity = 512) : slots(capacity), mask(capacity - 1) {
+        Q_ASSERT((capacity & (capacity - 1)) == 0);
+    }
+
+    InsertResult insert(quint16 sequence, qint64 playoutUs, const QByteArray& packet) {
+        if (!started) {
+            started = true;
+            head = sequence;
+        }
+        const qint16 ahead = RtpPacket::sequenceDiff(sequence, head);
+        if (ahead > mask || ahead < -mask) {
+            // Too far off to be jitter, the sender restarted or skipped: start over from here.
+            // Backwards too, or a sender that restarted lower would be dropped as late for good
+            clear();
+            started = true;
+            head = sequence;
+        } else if (ahead < 0) {
+            lateCount++;
+            return InsertResult::Late;
+        }
+        Slot& slot = slots[sequence & mask];
+        if (slot.used) {
+            return InsertResult::Duplicate;
+        }
+        slot = { packet, sequence, playoutUs, true };
+        count++;
+        return InsertResult::Stored;
+    }
+
+    /** @return Playout time of the next packet to release, or -1 if empty. */
+    qint64 nextPlayoutUs() const {
+        const Slot* slot = nextStored();
+        return slot ? slot->playoutUs : -1;
+    }
+
+    /** @brief Releases the next packet if it is due at nowUs, skipping lost ones before it. */
+    bool popDue(qint64 nowUs, QByteArray& packet) {
+        const Slot* next = nextStored();
+        if (!next || next->playoutUs > nowUs) {
+            return false;
+        }
+        const quint16 sequence = next->sequence;
+        lostCount += static_cast<quint16>(sequence - head);
+        Slot& slot = slots[sequence & mask];
+        packet = std::move(slot.packet);
+        slot = Slot();
+        count--;
+        head = static_cast<quint16>(sequence + 1);
+        return true;
+    }
+
+    void clear() {
+        std::fill(slots.begin(), slots.end(), Slot());
+        count = 0;
+        started = false;
+    }
+
+    bool isEmpty() const { return count == 0; }
+    quint64 lost() const { return lostCount; }
+    quint64 late() const { return lateCount; }
+
+private:
+    struct Slot {
+        QByteArray packet;
+        quint16 sequence = 0;
+        qint64 playoutUs = 0;
+        bool used = false;
+    };
+
+    const Slot* nextStored() const {
+        if (count == 0) {
+            return nullptr;
+        }
+        for (int i = 0; i <= mask; i++) {
+            const Slot& slot = slots[(head + i) & mask];
+            if (slot.used) {
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    std::vector<Slot> slots;
+    int mask;
+    int count = 0;
+    bool started = false;
+    quint16 head = 0;   // next sequence number to release
+    quint64 lostCount = 0;
+    quint64 lateCount = 0;
+};
+
+#endif // JITTERBUFFER_H
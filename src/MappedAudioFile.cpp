@@ -0,0 +1,190 @@
+// MappedAudioFile.cpp
+#include <QDebug>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QtEndian>
+#include <cstring>
+#include <sys/mman.h>
+#include "MappedAudioFile.h"
+
+namespace {
+// Mappings currently in use by canonical path, so concurrent streams of one file share the pages
+QMutex mappingsMutex;
+QHash<QString, std::weak_ptr<const MappedAudioFile>> mappings;
+
+constexpr quint16 WavFormatPcm = 1;
+constexpr quint16 WavFormatFloat = 3;
+constexpr quint16 WavFormatExtensible = 0xFFFE;
+}
+
+std::shared_ptr<const MappedAudioFile> MappedAudioFile::open(const QString& path, const QAudioFormat& rawFormat)
+{
+    // Relative paths and symlinks to one file must share its mapping
+    const QString canonicalPath = QFileInfo(path).canonicalFilePath();
+    if (canonicalPath.isEmpty()) {
+        qWarning() << "MappedAudioFile::open - File does not exist: " << path;
+        return nullptr;
+    }
+    QMutexLocker locker(&mappingsMutex);
+    if (auto existing = mappings.value(canonicalPath).lock()) {
+        if (existing->isRaw() && rawFormat.isValid() && rawFormat != existing->format()) {
+            qWarning() << "MappedAudioFile::open - Raw file already mapped with another format: " << canonicalPath;
+            return nullptr;
+        }
+        return existing;
+    }
+    std::shared_ptr<MappedAudioFile> mapped(new MappedAudioFile(canonicalPath));
+    if (!mapped->map(rawFormat)) {
+        // The destructor takes the lock as well
+        locker.unlock();
+        return nullptr;
+    }
+    mappings.insert(canonicalPath, mapped);
+    return mapped;
+}
+
+MappedAudioFile::MappedAudioFile(const QString& path)
+    : file(path)
+{}
+
+MappedAudioFile::~MappedAudioFile()
+{
+    if (mapping) {
+        file.unmap(mapping);
+    }
+    QMutexLocker locker(&mappingsMutex);
+    if (auto it = mappings.find(file.fileName()); it != mappings.end() && it->expired()) {
+        mappings.erase(it);
+    }
+}
+
+bool MappedAudioFile::map(const QAudioFormat& rawFormat)
+{
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "MappedAudioFile::map - Failed to open file: " << file.fileName();
+        return false;
+    }
+    mappingSize = file.size();
+    mapping = mappingSize > 0 ? file.map(0, mappingSize) : nullptr;
+    if (!mapping) {
+        qWarning() << "MappedAudioFile::map - Failed to map file: " << file.fileName();
+        return false;
+    }
+    // The samples are consumed front to back; let the kernel read ahead aggressively
+    // and drop pages behind the read position early
+    madvise(mapping, static_cast<size_t>(mappingSize), MADV_SEQUENTIAL);
+
+    if (mappingSize >= 12 && std::memcmp(mapping, "RIFF", 4) == 0 && std::memcmp(mapping + 8, "WAVE", 4) == 0) {
+        return parseWavHeader(mapping, mappingSize);
+    }
+    if (!rawFormat.isValid()) {
+        qWarning() << "MappedAudioFile::map - No WAV header and no raw PCM format given: " << file.fileName();
+        return false;
+    }
+    audioFormat = rawFormat;
+    raw = true;
+    pcm = reinterpret_cast<const char*>(mapping);
+    pcmBytes = mappingSize - mappingSize % audioFormat.bytesPerFrame();
+    return true;
+}
+
+bool MappedAudioFile::parseWavHeader(const uchar* data, qint64 size)
+{
+    bool haveFormat = false;
+    qint64 offset = 12;
+    while (offset + 8 <= size) {
+        const uchar* chunk = data + offset;
+        const qint64 chunkSize = qFromLittleEndian<quint32>(chunk + 4);
+        const qint64 bodyOffset = offset + 8;
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && bodyOffset + 16 <= size) {
+            quint16 formatTag = qFromLittleEndian<quint16>(chunk + 8);
+            const quint16 channels = qFromLittleEndian<quint16>(chunk + 10);
+            const quint32 sampleRate = qFromLittleEndian<quint32>(chunk + 12);
+            const quint16 bitsPerSample = qFromLittleEndian<quint16>(chunk + 22);
+            if (formatTag == WavFormatExtensible && chunkSize >= 26 && bodyOffset + 26 <= size) {
+                // The first two bytes of the sub-format GUID carry the actual format tag
+                formatTag = qFromLittleEndian<quint16>(chunk + 32);
+            }
+            audioFormat.setChannelCount(channels);
+            audioFormat.setSampleRate(static_cast<int>(sampleRate));
+            if (formatTag == WavFormatFloat && bitsPerSample == 32) {
+                audioFormat.setSampleFormat(QAudioFormat::Float);
+            } else if (formatTag == WavFormatPcm && bitsPerSample == 8) {
+                audioFormat.setSampleFormat(QAudioFormat::UInt8);
+            } else if (formatTag == WavFormatPcm && bitsPerSample == 16) {
+                audioFormat.setSampleFormat(QAudioFormat::Int16);
+            } else if (formatTag == WavFormatPcm && bitsPerSample == 32) {
+                audioFormat.setSampleFormat(QAudioFormat::Int32);
+            } else {
+                qWarning() << "MappedAudioFile::parseWavHeader - Unsupported format" << formatTag << bitsPerSample << "bit:" << file.fileName();
+                return false;
+            }
+            haveFormat = true;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!haveFormat || !audioFormat.isValid()) {
+                qWarning() << "MappedAudioFile::parseWavHeader - data chunk before fmt chunk: " << file.fileName();
+                return false;
+            }
+            // Writers that stream may leave the size unpatched; trust the file size then
+            const qint64 available = size - bodyOffset;
+            qint64 bytes = (chunkSize == 0 || chunkSize > available) ? available : chunkSize;
+            pcm = reinterpret_cast<const char*>(data + bodyOffset);
+            pcmBytes = bytes - bytes % audioFormat.bytesPerFrame();
+            return true;
+        }
+        // Chunks are padded to an even size
+        offset = bodyOffset + chunkSize + (chunkSize & 1);
+    }
+    qWarning() << "MappedAudioFile::parseWavHeader - No data chunk: " << file.fileName();
+    return false;
+}
+
+FileAudioSource::FileAudioSource(std::shared_ptr<const MappedAudioFile> file, int packetMs, bool loop, QObject* parent)
+    : QObject(parent)
+    , file(std::move(file))
+    , packetBytes(this->file->format().bytesForDuration(qint64(packetMs) * 1000))
+    , loop(loop)
+{
+    timer.setTimerType(Qt::PreciseTimer);
+    timer.setInterval(packetMs);
+    connect(&timer, &QTimer::timeout, this, &FileAudioSource::sendDuePackets);
+}
+
+void FileAudioSource::start()
+{
+    if (timer.isActive() || packetBytes <= 0) {
+        return;
+    }
+    sentBytes = 0;
+    clock.start();
+    sendDuePackets();
+    timer.start();
+}
+
+void FileAudioSource::stop()
+{
+    timer.stop();
+}
+
+void FileAudioSource::sendDuePackets()
+{
+    const auto& format = file->format();
+    // Everything up to the current time is due; send it in whole packets
+    const qint64 dueBytes = format.bytesForDuration(clock.nsecsElapsed() / 1000) + packetBytes;
+    while (sentBytes + packetBytes <= dueBytes) {
+        if (position >= file->pcmSize()) {
+            if (!loop) {
+                stop();
+                emit finished();
+                return;
+            }
+            position = 0;
+        }
+        const qint64 length = qMin(packetBytes, file->pcmSize() - position);
+        emit audioDataProvided(QByteArray::fromRawData(file->pcmData() + position, static_cast<qsizetype>(length)));
+        position += length;
+        sentBytes += packetBytes;
+    }
+}
@@ -0,0 +1,91 @@
+// MappedAudioFile.h
+#ifndef MAPPEDAUDIOFILE_H
+#define MAPPEDAUDIOFILE_H
+#include <QObject>
+#include <QFile>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QAudioFormat>
+#include <memory>
+
+/**
+ * @brief Read-only memory mapping of a WAV or raw PCM file.
+ *
+ * The header is parsed once when the file is opened; afterwards the PCM samples are
+ * read straight from the mapped pages, so serving a file needs no decode thread and
+ * no per-stream copy. Mappings are shared: opening the same file again, by any path
+ * that resolves to it, while another stream still holds it returns the existing mapping.
+ */
+class MappedAudioFile
+{
+public:
+    /**
+     * @brief Maps the file at path.
+     * @param rawFormat Format used when the file has no RIFF/WAVE header (raw PCM).
+     * @return The mapping, or nullptr if the file can not be mapped, its header is invalid,
+     * or it is a raw file already mapped with a different rawFormat.
+     */
+    static std::shared_ptr<const MappedAudioFile> open(const QString& path, const QAudioFormat& rawFormat = QAudioFormat());
+    ~MappedAudioFile();
+    MappedAudioFile(const MappedAudioFile&) = delete;
+    MappedAudioFile& operator=(const MappedAudioFile&) = delete;
+
+    const QAudioFormat& format() const { return audioFormat; }
+    const char* pcmData() const { return pcm; }
+    qint64 pcmSize() const { return pcmBytes; }
+    QString path() const { return file.fileName(); }
+    /** @brief True if the format came from rawFormat rather than a WAV header. */
+    bool isRaw() const { return raw; }
+
+private:
+    explicit MappedAudioFile(const QString& path);
+    bool map(const QAudioFormat& rawFormat);
+    bool parseWavHeader(const uchar* data, qint64 size);
+
+    QFile file;
+    uchar* mapping = nullptr;
+    qint64 mappingSize = 0;
+    const char* pcm = nullptr;
+    qint64 pcmBytes = 0;
+    QAudioFormat audioFormat;
+    bool raw = false;
+};
+
+/**
+ * @brief Plays a mapped file out in real time as fixed-duration packets.
+ *
+ * Emits audioDataProvided() like IAudioCapture, so it can feed AudioService in place of
+ * a capture device. Packets are QByteArray::fromRawData() views into the mapping; a
+ * receiver that keeps one beyond the lifetime of the source must detach (copy) it.
+ * Pacing follows a monotonic clock, so timer jitter does not accumulate into drift.
+ */
+class FileAudioSource : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FileAudioSource(std::shared_ptr<const MappedAudioFile> file, int packetMs = 20, bool loop = false, QObject* parent = nullptr);
+    virtual ~FileAudioSource() = default;
+    void start();
+    void stop();
+    bool isActive() const { return timer.isActive(); }
+    std::shared_ptr<const MappedAudioFile> getFile() const { return file; }
+
+signals:
+    void audioDataProvided(const QByteArray& audioData);
+    void finished();
+
+private slots:
+    void sendDuePackets();
+
+private:
+    std::shared_ptr<const MappedAudioFile> file;
+    qint64 packetBytes;
+    qint64 position = 0;
+    qint64 sentBytes = 0;
+    bool loop;
+    QTimer timer;
+    QElapsedTimer clock;
+};
+
+#endif // MAPPEDAUDIOFILE_H
@@ -16,6 +16,7 @@
 #include <QDataStream>
 #include <QDebug>
 #include <QUrl>
+#include "WavFileWriter.h"
 
 /**
 * @brief The IAudioCapture class is an interface for capturing audio data.
@@ -84,6 +85,7 @@ public:
         : AudioCapture(parent), audioRecorder(new QMediaRecorder(this)), audioInput(nullptr), audioBuffer(nullptr)
     {
         connect(audioRecorder, &QMediaRecorder::recorderStateChanged, this, &AudioRecorder::handleStateChanged);
+        connect(this, &IAudioCapture::audioDataProvided, this, &AudioRecorder::appendToFile);
     }
     void start() override
     {
@@ -95,12 +97,19 @@ public:
         format.setSampleFormat(QAudioFormat::Int16);
         audioInput = new QAudioInput(this);
         connect(audioBuffer, &QIODevice::readyRead, this, &AudioRecorder::readData);
+        // Captured data is streamed to disk as it arrives instead of being collected in memory
+        if (!wavWriter.open(filePath.toStdString(), WavFormat{44100, 1, 16})) {
+            qWarning() << "AudioRecorder::start - Failed to open file: " << filePath;
+        }
     }
     void stop() override
     {
         audioInput->deleteLater();
         audioBuffer = nullptr;
+        finishFile();
     }
+    /*! @brief Writes a complete in-memory clip as a WAV file.
+    * Recording sessions do not use this; they are streamed by StreamingWavWriter. */
     bool saveToWav(const QString& filePath, const QByteArray& audioData)
     {
         QFile file(filePath);
@@ -162,27 +171,40 @@ public slots:
         return true;
     }
 private slots:
+    /*! @brief Queues captured PCM for the background writer; never blocks the capture path. */
+    void appendToFile(const QByteArray& audioData) {
+        if (wavWriter.isOpen()) {
+            wavWriter.write(audioData.constData(), audioData.size());
+        }
+    }
     void handleStateChanged(QMediaRecorder::RecorderState newState) {
         if (newState == QMediaRecorder::StoppedState)
         {
-            const QString& filePath = audioRecorder->outputLocation().toLocalFile();
-            const QByteArray& audioData = audioRecorder->audioSampleRate() == 16
-                ? audioBuffer->readAll()
-                : QByteArray();
-            bool savingSuccessful = saveToWav(filePath, audioData);
-            if (savingSuccessful) {
-                qDebug() << "Audio saved successfully to: " << filePath;
-            }
-            else {
-                qWarning() << "Failed to save audio to: " << filePath;
-            }
+            finishFile();
         }
     }
 private:
+    void finishFile() {
+        if (!wavWriter.isOpen()) {
+            return;
+        }
+        bool savingSuccessful = wavWriter.close();
+        if (savingSuccessful) {
+            qDebug() << "Audio saved successfully to: " << filePath;
+        }
+        else {
+            qWarning() << "Failed to save audio to: " << filePath;
+        }
+        if (wavWriter.droppedBytes() > 0) {
+            qWarning() << "AudioRecorder - writer fell behind, dropped bytes: " << wavWriter.droppedBytes();
+        }
+    }
+
     QMediaRecorder* audioRecorder;
     QAudioInput* audioInput;
     QIODevice* audioBuffer;
     QString filePath;
+    StreamingWavWriter wavWriter;
 };
 
 
@@ -5,10 +5,12 @@
 #include <algorithm>
 #include <vector>
 #include <cmath>
+#include <cstring>
 #include <memory>
 #include "3rdParty/kissfft/kiss_fft.h"
 #include "3rdParty/kissfft/kiss_fftr.h"
 #include "kiss_fft.h"
+#include "SpectrumFrame.h"
 /*
 FFT (Fast Fourier Transform) is an algorithm used to efficiently compute the Discrete Fourier Transform (DFT) of a sequence of values. The DFT is a mathematical operation that converts a time-domain signal into its frequency-domain representation. The FFT algorithm reduces the number of computations required to calculate the DFT, making it more efficient for use in computing devices.
 */
@@ -57,7 +59,8 @@ class AudioProcessor
 public:
     explicit AudioProcessor(const int& sampleRate = 44100)
         : _sampleRate(sampleRate),
-        _fftWrapper(std::make_unique<KissFftWrapper>(4096))  // Initialize KissFftWrapper with a size of 4096
+        _fftWrapper(std::make_unique<KissFftWrapper>(FftSize)),
+        _samples(FftSize)
     {}
     virtual ~AudioProcessor() = default;
 
@@ -77,16 +80,30 @@ public:
         std::vector<double> fftData = _fftWrapper->performFFT(audioData);
         // Find the dominant frequency
         int dominantFrequencyIndex = findDominantFrequencyIndex(fftData, _fftWrapper.get());
-        // Convert the dominant frequency index to actual frequency
-        double frequency = (dominantFrequencyIndex + 0.5) * _sampleRate / fftData.size();
-        // Convert frequency to semitone
-        double semitone;
-        if (frequency <= 0) {
-            semitone = -INFINITY;
-        } else {
-            semitone = 12 * log2(frequency / 440.0) + 69;
+        return semitoneForIndex(dominantFrequencyIndex, fftData.size());
+    }
+
+    /*! @brief Analyzes one chunk of 16-bit samples into a caller-owned frame.
+    * Short chunks are zero-padded to the FFT size. The frame is written in place,
+    * so it can be the write slot of a SpectrumFrameBuffer.
+    * @return The dominant semitone, also stored in frame.semitone. */
+    double analyzeBuffer(const char *buf, size_t size, SpectrumFrame& frame)
+    {
+        const size_t sampleCount = std::min(size / sizeof(int16_t), _samples.size());
+        std::memcpy(_samples.data(), buf, sampleCount * sizeof(int16_t));
+        std::fill(_samples.begin() + sampleCount, _samples.end(), 0);
+        const std::vector<double> fftData = _fftWrapper->performFFT(_samples);
+
+        // Fold the bins into bands, keeping the strongest bin of each band
+        const size_t binsPerBand = std::max<size_t>(1, fftData.size() / SpectrumFrame::BandCount);
+        for (int band = 0; band < SpectrumFrame::BandCount; band++) {
+            const auto first = fftData.begin() + std::min(fftData.size(), band * binsPerBand);
+            const auto last = fftData.begin() + std::min(fftData.size(), (band + 1) * binsPerBand);
+            frame.bands[band] = first < last ? static_cast<float>(*std::max_element(first, last)) : 0.0f;
         }
-        return semitone;
+        const int dominantFrequencyIndex = findDominantFrequencyIndex(fftData, _fftWrapper.get());
+        frame.semitone = semitoneForIndex(dominantFrequencyIndex, fftData.size());
+        return frame.semitone;
     }
     
     int findDominantFrequencyIndex(const std::vector<double> &fftData, const KissFftWrapper* _fftWrapper)
@@ -111,8 +128,23 @@ public:
     }
 
 private:
-    std::unique_ptr<KissFftWrapper> _fftWrapper;
+    static constexpr int FftSize = 4096;
+
+    double semitoneForIndex(int dominantFrequencyIndex, size_t binCount) const
+    {
+        // Convert the dominant frequency index to actual frequency
+        double frequency = (dominantFrequencyIndex + 0.5) * _sampleRate / binCount;
+        // Convert frequency to semitone
+        if (frequency <= 0) {
+            return -INFINITY;
+        }
+        return 12 * log2(frequency / 440.0) + 69;
+    }
+
     int _sampleRate;
+    std::unique_ptr<KissFftWrapper> _fftWrapper;
+    //! Reused input buffer for analyzeBuffer()
+    std::vector<int16_t> _samples;
 };
 
 #endif // AUDIOPROCESSOR_H
@@ -20,6 +20,7 @@
 #include "AudioCapture.h"
 #include "AudioProcessor.h"
 #include "SpectrumVisualizer.h"
+#include "VisualizationScheduler.h"
 
 // Segregated interfaces from IAudioHandler
 class IAudioDataReceiver {
@@ -125,36 +126,48 @@ private:
 };
 
 
+/*! @brief Runs the analysis on the audio thread and publishes the results.
+* Each analyzed chunk, including its peak-hold state, is written straight into the
+* producer slot of the frame buffer. Nothing is sent to the GUI per chunk; the
+* VisualizationScheduler picks up the newest frame once per rendered frame. */
 class VisualizerUpdater : public QObject
 {
     Q_OBJECT
 public:
-    explicit VisualizerUpdater(VisualizerQml* visualizer, std::shared_ptr<AudioProcessor> audioProcessor, QObject* parent = nullptr)
-        : QObject(parent), visualizer(visualizer), audioProcessor(audioProcessor)
+    explicit VisualizerUpdater(std::shared_ptr<AudioProcessor> audioProcessor,
+                               std::shared_ptr<SpectrumFrameBuffer> frameBuffer = nullptr, QObject* parent = nullptr)
+        : QObject(parent), audioProcessor(audioProcessor),
+        frameBuffer(frameBuffer ? std::move(frameBuffer) : std::make_shared<SpectrumFrameBuffer>())
     {
-        connect(this, &VisualizerUpdater::semitoneChanged, visualizer, &VisualizerQml::updateVisualization);
+    }
+
+    std::shared_ptr<SpectrumFrameBuffer> getFrameBuffer() const {
+        return frameBuffer;
     }
 
 signals:
-    void semitoneChanged(QString note);
+    /*! @brief Emitted on the analysis thread after a frame was published. Connect directly. */
+    void framePublished();
 
 public slots:
     void handleAudioData(const QByteArray& audioData) {
         if (audioData.isEmpty()) {
             return;
         }
-        const char* dataPtr = audioData.constData();
-        const auto dataSize = audioData.size();
-        const auto semitone = audioProcessor->processBuffer(dataPtr, dataSize);
+        SpectrumFrame& frame = frameBuffer->writeBuffer();
+        frame.sequence = ++sequence;
+        audioProcessor->analyzeBuffer(audioData.constData(), audioData.size(), frame);
+        peakTracker.apply(frame);
+        frameBuffer->publish();
 
-        // Emit the semitone changed signal
-        QString note = QString::number(semitone, 'f', 2);
-        emit semitoneChanged(note);
+        emit framePublished();
     }
 
 private:
-    VisualizerQml* visualizer;
     std::shared_ptr<AudioProcessor> audioProcessor;
+    std::shared_ptr<SpectrumFrameBuffer> frameBuffer;
+    SpectrumPeakTracker peakTracker;
+    uint64_t sequence = 0;
 };
 
 class AudioColorProvider : public QObject, public IAudioDataReceiver
@@ -166,10 +179,21 @@ public:
     {
         auto audioProcessor = std::make_shared<AudioProcessor>();
         audioDataHandler = std::make_shared<AudioDataHandler>(audioProcessor);
-        visualizerUpdater = std::make_shared<VisualizerUpdater>(visualizer, audioProcessor);
+        visualizerUpdater = std::make_shared<VisualizerUpdater>(audioProcessor);
+        scheduler = std::make_shared<VisualizationScheduler>(visualizerUpdater->getFrameBuffer());
 
         connect(audioDataHandler.get(), &AudioDataHandler::audioDataReady, visualizerUpdater.get(), &VisualizerUpdater::handleAudioData);
-        connect(visualizerUpdater.get(), &VisualizerUpdater::semitoneChanged, this, &AudioColorProvider::semitoneChanged);
+        connect(visualizerUpdater.get(), &VisualizerUpdater::framePublished, scheduler.get(), &VisualizationScheduler::requestWake, Qt::DirectConnection);
+        connect(scheduler.get(), &VisualizationScheduler::frameReady, this, &AudioColorProvider::frameReady);
+        connect(scheduler.get(), &VisualizationScheduler::semitoneChanged, this, &AudioColorProvider::semitoneChanged);
+        if (visualizer) {
+            connect(scheduler.get(), &VisualizationScheduler::semitoneChanged, visualizer, &VisualizerQml::updateVisualization);
+        }
+    }
+
+    /*! @brief Paces the visualization updates to the render loop of the given window. */
+    void attachWindow(QQuickWindow* window) {
+        scheduler->attachWindow(window);
     }
 
     void handleAudioData(const QByteArray& audioData) override {
@@ -177,7 +201,8 @@ public:
     }
 
 signals:
-    void semitoneChanged(QString note);
+    void semitoneChanged(double semitone);
+    void frameReady(const SpectrumFrame& frame);
     void colorChanged(QString color);
     void audioDataReady(const QByteArray& audioData);
 
@@ -198,6 +223,7 @@ public slots:
 private:
     std::shared_ptr<AudioDataHandler> audioDataHandler;
     std::shared_ptr<VisualizerUpdater> visualizerUpdater;
+    std::shared_ptr<VisualizationScheduler> scheduler;
     std::shared_ptr<AudioProcessor> audioProcessor;
 };
 
@@ -73,6 +73,7 @@ public:
             QByteArray tempData;
             tempData.resize(socket->pendingDatagramSize());
             socket->readDatagram(tempData.data(), tempData.size());
+            emit datagramReceived(tempData);
             data.append(tempData);
         }
         return data;
@@ -82,6 +83,8 @@ public:
     }
 signals:
     void audioDataProvided(const QByteArray& data);
+    /*! @brief Emitted by read() for every datagram, keeping packet boundaries (e.g. for StreamRecordingWriter). */
+    void datagramReceived(const QByteArray& datagram);
 private:
     QSharedPointer<QUdpSocket> socket;
     QHostAddress multicastGroupAddress;
@@ -0,0 +1,128 @@
+// SpectrumFrame.h
+#ifndef SPECTRUMFRAME_H
+#define SPECTRUMFRAME_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+/*! @brief One analysis result handed from the audio thread to the renderer.
+* The band array is fixed-size so that publishing a frame never allocates. */
+struct SpectrumFrame
+{
+    static constexpr int BandCount = 64;
+    //! Incremented by the producer for every published frame.
+    uint64_t sequence = 0;
+    //! Dominant semitone (MIDI note number, 69 = A4), -INFINITY when silent.
+    double semitone = -INFINITY;
+    //! Magnitude of each band, normalized by the FFT size.
+    std::array<float, BandCount> bands{};
+    //! Held and decaying maximum of each band, see SpectrumPeakTracker.
+    std::array<float, BandCount> peaks{};
+};
+
+/*! @brief Peak-hold with exponential decay, run on the analysis thread.
+* A band's peak is held for holdTime after it was last reached and then decays
+* towards the current level with the time constant decayTime. Computing this
+* per analyzed chunk keeps it correct no matter how many frames the renderer drops. */
+class SpectrumPeakTracker
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit SpectrumPeakTracker(std::chrono::milliseconds holdTime = std::chrono::milliseconds(400),
+                                 std::chrono::milliseconds decayTime = std::chrono::milliseconds(300))
+        : holdTime(holdTime), decayTime(decayTime)
+    {}
+
+    /*! @brief Updates the peaks from frame.bands and stores them in frame.peaks. */
+    void apply(SpectrumFrame& frame, Clock::time_point now = Clock::now()) {
+        const double elapsed = std::chrono::duration<double>(now - lastUpdate).count();
+        const float decay = lastUpdate == Clock::time_point{}
+            ? 0.0f
+            : static_cast<float>(std::exp(-elapsed / std::chrono::duration<double>(decayTime).count()));
+        lastUpdate = now;
+        for (int i = 0; i < SpectrumFrame::BandCount; i++) {
+            const float level = frame.bands[i];
+            if (level >= peaks[i]) {
+                peaks[i] = level;
+                holdUntil[i] = now + holdTime;
+            } else if (now > holdUntil[i]) {
+                peaks[i] = level + (peaks[i] - level) * decay;
+            }
+        }
+        frame.peaks = peaks;
+    }
+
+private:
+    std::chrono::milliseconds holdTime;
+    std::chrono::milliseconds decayTime;
+    Clock::time_point lastUpdate{};
+    std::array<float, SpectrumFrame::BandCount> peaks{};
+    std::array<Clock::time_point, SpectrumFrame::BandCount> holdUntil{};
+};
+
+/*! @brief Wait-free single-producer/single-consumer triple buffer.
+* The producer fills writeBuffer() and calls publish(); the consumer calls update()
+* and then reads readBuffer(). Neither side ever blocks and the consumer always
+* sees the most recent complete value; intermediate values are dropped. */
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /*! @brief Slot owned by the producer until the next publish(). */
+    T& writeBuffer() {
+        return slots[backIndex].value;
+    }
+
+    /*! @brief Makes the content of writeBuffer() visible to the consumer. */
+    void publish() {
+        const auto previous = middle.exchange(backIndex | DirtyBit, std::memory_order_acq_rel);
+        backIndex = previous & IndexMask;
+    }
+
+    /*! @brief Takes the latest published value, if there is one.
+    * @return True if readBuffer() changed since the last call. */
+    bool update() {
+        if (!hasPending()) {
+            return false;
+        }
+        const auto previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & IndexMask;
+        return true;
+    }
+
+    /*! @brief Whether the producer published a value not yet taken by update(). */
+    bool hasPending() const {
+        return middle.load(std::memory_order_acquire) & DirtyBit;
+    }
+
+    /*! @brief Slot owned by the consumer, valid until the next update(). */
+    const T& readBuffer() const {
+        return slots[frontIndex].value;
+    }
+
+private:
+    static constexpr uint8_t IndexMask = 0x3;
+    static constexpr uint8_t DirtyBit = 0x4;
+
+    // Each slot on its own cache line, so the two threads never share one
+    struct alignas(64) Slot {
+        T value{};
+    };
+    std::array<Slot, 3> slots;
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t backIndex = 0;
+    alignas(64) uint8_t frontIndex = 2;
+};
+
+using SpectrumFrameBuffer = TripleBuffer<SpectrumFrame>;
+
+#endif // SPECTRUMFRAME_H
@@ -3,9 +3,13 @@
 #define SPECTRUMVISUALIZER_H
 
 #include <QObject>
+#include <QColor>
 #include <QPainter>
 #include <QQuickPaintedItem>
 #include <QVariantList>
+#include <algorithm>
+#include <cmath>
+#include "SpectrumFrame.h"
 
 enum class SemitoneColor {
    ORANGE,
@@ -39,16 +43,17 @@ public:
 signals:
     void colorChanged(QString color);
 public slots:
-    void updateVisualization(const QString& color)
+    void updateVisualization(double semitone)
     {
-        if (color.isEmpty()) {
-            // Error: color is invalid
+        if (!std::isfinite(semitone)) {
+            // Silence: no dominant frequency
             return;
         }
-        float amplitude = color.toFloat();
-        QColor ampColor = QColor::fromHslF(amplitude, 1.0, 0.5);
+        // Map the pitch class to hue, one twelfth of the color wheel per semitone
+        const double pitchClass = std::fmod(std::fmod(semitone, 12.0) + 12.0, 12.0);
+        QColor ampColor = QColor::fromHslF(pitchClass / 12.0, 1.0, 0.5);
         // Emit the color changed signal
-        emit colorChanged(color);
+        emit colorChanged(ampColor.name());
     }
 };
 
@@ -63,23 +68,27 @@ public:
    SpectrumVisualizer(const SpectrumVisualizer& other) = delete;  // Prevents copying
    void operator=(const SpectrumVisualizer&) = delete; // Prevents assignment
 public slots:
+   /*! @brief Stores the frame to draw and schedules a repaint.
+   * Called by VisualizationScheduler at most once per rendered frame. */
+   void setFrame(const SpectrumFrame& frame) {
+       m_frame = frame;
+       update();
+   }
    void paint(QPainter *painter) override {
+       const SpectrumFrame& frame = m_frame;
+
        // Calculate the width of each rect
        int rectWidth = width() / m_numBars;
 
        // Calculate the maximum amplitude value
-       qreal maxAmplitude = 0;
-       if (!m_data.isEmpty()) { // Check if m_data is not empty before computing maxAmplitude
-           for (int i = 0; i < m_data.size(); i++) {
-               if (m_data[i] > maxAmplitude) {
-                   maxAmplitude = m_data[i];
-               }
-           }
+       qreal maxAmplitude = *std::max_element(frame.peaks.begin(), frame.peaks.end());
+       if (maxAmplitude <= 0) {
+           return;
        }
        // Draw the rects
        for (int i = 0; i < m_numBars; i++) {
            // Calculate the height of each rect based on amplitude
-           qint16 amplitude = m_data[i * m_data.size() / m_numBars];
+           qreal amplitude = frame.bands[i * SpectrumFrame::BandCount / m_numBars];
            qreal rectHeight = amplitude / maxAmplitude * height();
            qreal opacity = amplitude / maxAmplitude;
            // Set the color and opacity of the painter based on amplitude
@@ -88,6 +97,10 @@ public slots:
            painter->setBrush(QBrush(color, Qt::SolidPattern));
            // Draw the rect
            painter->drawRect(QRect(i * rectWidth, height() - rectHeight, rectWidth, rectHeight));
+           // Draw the held peak as a thin line above the bar
+           qreal peakHeight = frame.peaks[i * SpectrumFrame::BandCount / m_numBars] / maxAmplitude * height();
+           painter->setOpacity(1.0);
+           painter->drawLine(QLineF(i * rectWidth, height() - peakHeight, (i + 1) * rectWidth, height() - peakHeight));
        }
    }
    std::string colorForSemitone(SemitoneColor color) {
@@ -115,9 +128,8 @@ private:
    SpectrumVisualizer(QQuickItem *parent = nullptr)
    : QQuickPaintedItem(parent), m_numBars(10) // Initialize m_numBars to some default value
    {}
-   QVector<double> m_spectrumData;
    int m_numBars;
-   QVector<qint16> m_data; // Added missing member variable
+   SpectrumFrame m_frame;
 };
 
 #endif // SPECTRUMVISUALIZER_H
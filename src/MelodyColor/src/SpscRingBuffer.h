@@ -0,0 +1,76 @@
+// SpscRingBuffer.h
+#ifndef SPSCRINGBUFFER_H
+#define SPSCRINGBUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+/*! @brief Lock-free single-producer/single-consumer byte ring.
+* The capacity is rounded up to a power of two. write() and read() never block
+* and never allocate, so the producer side can run on the audio thread. */
+class SpscRingBuffer
+{
+public:
+    explicit SpscRingBuffer(size_t minCapacity)
+        : capacity(roundUpPowerOfTwo(minCapacity)), mask(capacity - 1), data(new char[capacity])
+    {}
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    /*! @brief Appends up to size bytes. Producer side only.
+    * @return Number of bytes accepted, less than size when the ring is full. */
+    size_t write(const char* src, size_t size) {
+        const size_t head = writeIndex.load(std::memory_order_relaxed);
+        const size_t tail = readIndex.load(std::memory_order_acquire);
+        const size_t count = std::min(size, capacity - (head - tail));
+        const size_t offset = head & mask;
+        const size_t first = std::min(count, capacity - offset);
+        std::memcpy(data.get() + offset, src, first);
+        std::memcpy(data.get(), src + first, count - first);
+        writeIndex.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    /*! @brief Removes up to size bytes into dst. Consumer side only.
+    * @return Number of bytes read. */
+    size_t read(char* dst, size_t size) {
+        const size_t tail = readIndex.load(std::memory_order_relaxed);
+        const size_t head = writeIndex.load(std::memory_order_acquire);
+        const size_t count = std::min(size, head - tail);
+        const size_t offset = tail & mask;
+        const size_t first = std::min(count, capacity - offset);
+        std::memcpy(dst, data.get() + offset, first);
+        std::memcpy(dst + first, data.get(), count - first);
+        readIndex.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    /*! @brief Bytes currently stored; exact only when called from one of the two sides. */
+    size_t size() const {
+        return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_acquire);
+    }
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+private:
+    static size_t roundUpPowerOfTwo(size_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const size_t capacity;
+    const size_t mask;
+    std::unique_ptr<char[]> data;
+    alignas(64) std::atomic<size_t> writeIndex{0};
+    alignas(64) std::atomic<size_t> readIndex{0};
+};
+
+#endif // SPSCRINGBUFFER_H
@@ -0,0 +1,378 @@
+// StreamRecording.h
+#ifndef STREAMRECORDING_H
+#define STREAMRECORDING_H
+#include <QObject>
+#include <QFile>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QDebug>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "AudioStreamer.h"
+
+/*
+Recorded stream container (all integers little-endian):
+
+    header   "BLSTREAM" | u32 version | u32 reserved
+    records  u64 timestampUs | u32 payloadSize | payload ...   (timestamps non-decreasing)
+    index    u64 timestampUs | u64 recordOffset ...            (sparse, one entry per IndexIntervalUs)
+    trailer  u64 indexOffset | u64 indexCount | "BLSTRIDX"
+
+The index lets a reader seek to any timestamp with a binary search plus a scan of at most
+one index interval. A file without a trailer (recording interrupted) is still readable;
+the reader rebuilds the index with a single scan.
+*/
+namespace StreamRecordingFormat {
+    constexpr char HeaderMagic[8] = {'B', 'L', 'S', 'T', 'R', 'E', 'A', 'M'};
+    constexpr char TrailerMagic[8] = {'B', 'L', 'S', 'T', 'R', 'I', 'D', 'X'};
+    constexpr quint32 Version = 1;
+    constexpr qint64 HeaderSize = 16;
+    constexpr qint64 RecordHeaderSize = 12;
+    constexpr qint64 IndexEntrySize = 16;
+    constexpr qint64 TrailerSize = 24;
+    constexpr qint64 IndexIntervalUs = 1'000'000;
+    constexpr quint32 MaxPayloadSize = 65535;
+
+    struct IndexEntry {
+        qint64 timestampUs;
+        qint64 offset;
+    };
+}
+
+/*! @brief Records packet payloads with their arrival time into a seekable container.
+* A failed write (e.g. a full disk) ends the recording: the file is closed without index and
+* trailer, so it holds exactly the records written before; the reader rebuilds the index. */
+class StreamRecordingWriter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit StreamRecordingWriter(QObject* parent = nullptr): QObject(parent)
+    {}
+    virtual ~StreamRecordingWriter() {
+        close();
+    }
+
+    /*! @brief Creates the file and writes the header.
+    * @return True on success. */
+    bool open(const QString& filePath) {
+        close();
+        failed = false;
+        file.setFileName(filePath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "StreamRecordingWriter::open - Failed to open file: " << filePath;
+            return false;
+        }
+        char header[StreamRecordingFormat::HeaderSize] = {};
+        std::memcpy(header, StreamRecordingFormat::HeaderMagic, 8);
+        qToLittleEndian<quint32>(StreamRecordingFormat::Version, header + 8);
+        if (!writeAll(header, sizeof(header))) {
+            return false;
+        }
+        index.clear();
+        lastTimestampUs = -1;
+        clock.start();
+        return true;
+    }
+
+    /*! @brief Appends one payload with an explicit timestamp (microseconds, non-decreasing). */
+    bool append(qint64 timestampUs, const QByteArray& payload) {
+        if (!file.isOpen() || payload.size() > qsizetype(StreamRecordingFormat::MaxPayloadSize)) {
+            return false;
+        }
+        timestampUs = std::max(timestampUs, lastTimestampUs);
+        const qint64 offset = file.pos();
+        char recordHeader[StreamRecordingFormat::RecordHeaderSize];
+        qToLittleEndian<quint64>(static_cast<quint64>(timestampUs), recordHeader);
+        qToLittleEndian<quint32>(static_cast<quint32>(payload.size()), recordHeader + 8);
+        if (!writeAll(recordHeader, sizeof(recordHeader)) || !writeAll(payload.constData(), payload.size())) {
+            return false;
+        }
+        // Indexed only once written, the index must not point past the data
+        if (index.empty() || timestampUs - index.back().timestampUs >= StreamRecordingFormat::IndexIntervalUs) {
+            index.push_back({timestampUs, offset});
+        }
+        lastTimestampUs = timestampUs;
+        return true;
+    }
+
+    /*! @brief Writes the index footer and closes the file.
+    * @return False if the recording failed, now or earlier. */
+    bool close() {
+        if (!file.isOpen()) {
+            return !failed;
+        }
+        // Buffered records hit the disk first, a failure here must not leave a trailer behind
+        if (!file.flush()) {
+            fail();
+            return false;
+        }
+        const qint64 indexOffset = file.pos();
+        for (const auto& entry : index) {
+            char raw[StreamRecordingFormat::IndexEntrySize];
+            qToLittleEndian<quint64>(static_cast<quint64>(entry.timestampUs), raw);
+            qToLittleEndian<quint64>(static_cast<quint64>(entry.offset), raw + 8);
+            if (!writeAll(raw, sizeof(raw))) {
+                return false;
+            }
+        }
+        char trailer[StreamRecordingFormat::TrailerSize];
+        qToLittleEndian<quint64>(static_cast<quint64>(indexOffset), trailer);
+        qToLittleEndian<quint64>(static_cast<quint64>(index.size()), trailer + 8);
+        std::memcpy(trailer + 16, StreamRecordingFormat::TrailerMagic, 8);
+        if (!writeAll(trailer, sizeof(trailer)) || !file.flush()) {
+            fail();
+            return false;
+        }
+        file.close();
+        return true;
+    }
+
+    /*! @return True if a write failed since open(). */
+    bool hasFailed() const {
+        return failed;
+    }
+
+signals:
+    /*! @brief Emitted once when a write fails; the recording is closed and stays readable. */
+    void recordingFailed(const QString& error);
+
+public slots:
+    /*! @brief Appends one received packet, timestamped with the time since open(). */
+    void appendPacket(const QByteArray& payload) {
+        append(clock.nsecsElapsed() / 1000, payload);
+    }
+
+private:
+    bool writeAll(const char* data, qint64 size) {
+        if (file.write(data, size) != size) {
+            fail();
+            return false;
+        }
+        return true;
+    }
+
+    void fail() {
+        if (!file.isOpen()) {
+            return;
+        }
+        const QString error = file.errorString();
+        qWarning() << "StreamRecordingWriter - Write failed, recording stopped: " << error;
+        failed = true;
+        // No trailer: the reader rebuilds the index from the records that made it to disk
+        file.close();
+        emit recordingFailed(error);
+    }
+
+    QFile file;
+    QElapsedTimer clock;
+    std::vector<StreamRecordingFormat::IndexEntry> index;
+    qint64 lastTimestampUs = -1;
+    bool failed = false;
+};
+
+/*! @brief Sequential reader with timestamp seeking for StreamRecordingWriter files. */
+class StreamRecordingReader
+{
+public:
+    struct Packet {
+        qint64 timestampUs = 0;
+        QByteArray payload;
+    };
+
+    /*! @brief Opens a recording and loads (or rebuilds) its index.
+    * @return True on success. */
+    bool open(const QString& filePath) {
+        file.close();
+        index.clear();
+        file.setFileName(filePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "StreamRecordingReader::open - Failed to open file: " << filePath;
+            return false;
+        }
+        char header[StreamRecordingFormat::HeaderSize];
+        if (file.read(header, sizeof(header)) != sizeof(header)
+            || std::memcmp(header, StreamRecordingFormat::HeaderMagic, 8) != 0
+            || qFromLittleEndian<quint32>(header + 8) != StreamRecordingFormat::Version) {
+            qWarning() << "StreamRecordingReader::open - Not a stream recording: " << filePath;
+            file.close();
+            return false;
+        }
+        if (!loadIndex()) {
+            rebuildIndex();
+        }
+        return file.seek(StreamRecordingFormat::HeaderSize);
+    }
+
+    /*! @brief Positions the reader at the first packet with timestamp >= timestampUs.
+    * Binary search in the index, then a scan of at most one index interval. */
+    bool seek(qint64 timestampUs) {
+        auto it = std::upper_bound(index.begin(), index.end(), timestampUs,
+            [](qint64 ts, const StreamRecordingFormat::IndexEntry& entry) { return ts < entry.timestampUs; });
+        const qint64 start = it == index.begin() ? StreamRecordingFormat::HeaderSize : std::prev(it)->offset;
+        if (!file.seek(start)) {
+            return false;
+        }
+        while (file.pos() < recordsEnd) {
+            const qint64 offset = file.pos();
+            char recordHeader[StreamRecordingFormat::RecordHeaderSize];
+            if (file.read(recordHeader, sizeof(recordHeader)) != sizeof(recordHeader)) {
+                return false;
+            }
+            if (static_cast<qint64>(qFromLittleEndian<quint64>(recordHeader)) >= timestampUs) {
+                return file.seek(offset);
+            }
+            file.seek(file.pos() + qFromLittleEndian<quint32>(recordHeader + 8));
+        }
+        return false;
+    }
+
+    /*! @brief Reads the packet at the current position.
+    * @return False at the end of the recording. */
+    bool readNext(Packet& packet) {
+        if (file.pos() + StreamRecordingFormat::RecordHeaderSize > recordsEnd) {
+            return false;
+        }
+        char recordHeader[StreamRecordingFormat::RecordHeaderSize];
+        if (file.read(recordHeader, sizeof(recordHeader)) != sizeof(recordHeader)) {
+            return false;
+        }
+        const quint32 size = qFromLittleEndian<quint32>(recordHeader + 8);
+        if (size > StreamRecordingFormat::MaxPayloadSize || file.pos() + size > recordsEnd) {
+            return false;
+        }
+        packet.timestampUs = static_cast<qint64>(qFromLittleEndian<quint64>(recordHeader));
+        packet.payload = file.read(size);
+        return packet.payload.size() == qsizetype(size);
+    }
+
+    qint64 firstTimestampUs() const {
+        return index.empty() ? 0 : index.front().timestampUs;
+    }
+
+private:
+    bool loadIndex() {
+        const qint64 size = file.size();
+        if (size < StreamRecordingFormat::HeaderSize + StreamRecordingFormat::TrailerSize) {
+            return false;
+        }
+        char trailer[StreamRecordingFormat::TrailerSize];
+        if (!file.seek(size - StreamRecordingFormat::TrailerSize)
+            || file.read(trailer, sizeof(trailer)) != sizeof(trailer)
+            || std::memcmp(trailer + 16, StreamRecordingFormat::TrailerMagic, 8) != 0) {
+            return false;
+        }
+        const qint64 indexOffset = static_cast<qint64>(qFromLittleEndian<quint64>(trailer));
+        const qint64 indexCount = static_cast<qint64>(qFromLittleEndian<quint64>(trailer + 8));
+        if (indexOffset < StreamRecordingFormat::HeaderSize
+            || indexOffset + indexCount * StreamRecordingFormat::IndexEntrySize != size - StreamRecordingFormat::TrailerSize
+            || !file.seek(indexOffset)) {
+            return false;
+        }
+        const QByteArray raw = file.read(indexCount * StreamRecordingFormat::IndexEntrySize);
+        if (raw.size() != indexCount * StreamRecordingFormat::IndexEntrySize) {
+            return false;
+        }
+        index.resize(static_cast<size_t>(indexCount));
+        for (qint64 i = 0; i < indexCount; i++) {
+            const char* entry = raw.constData() + i * StreamRecordingFormat::IndexEntrySize;
+            index[i] = {static_cast<qint64>(qFromLittleEndian<quint64>(entry)),
+                        static_cast<qint64>(qFromLittleEndian<quint64>(entry + 8))};
+        }
+        recordsEnd = indexOffset;
+        return true;
+    }
+
+    /*! Scans all records of a file that has no valid trailer; a torn last record is ignored. */
+    void rebuildIndex() {
+        index.clear();
+        recordsEnd = file.size();
+        qint64 offset = StreamRecordingFormat::HeaderSize;
+        file.seek(offset);
+        char recordHeader[StreamRecordingFormat::RecordHeaderSize];
+        while (file.read(recordHeader, sizeof(recordHeader)) == sizeof(recordHeader)) {
+            const qint64 timestampUs = static_cast<qint64>(qFromLittleEndian<quint64>(recordHeader));
+            const qint64 next = file.pos() + qFromLittleEndian<quint32>(recordHeader + 8);
+            if (next > file.size()) {
+                break;
+            }
+            if (index.empty() || timestampUs - index.back().timestampUs >= StreamRecordingFormat::IndexIntervalUs) {
+                index.push_back({timestampUs, offset});
+            }
+            offset = next;
+            file.seek(offset);
+        }
+        recordsEnd = offset;
+    }
+
+    QFile file;
+    std::vector<StreamRecordingFormat::IndexEntry> index;
+    qint64 recordsEnd = 0;
+};
+
+/*! @brief Replays a recording through an IStreamer, in real time or faster. */
+class StreamRecordingPlayer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit StreamRecordingPlayer(QSharedPointer<IStreamer> streamer, QObject* parent = nullptr)
+        : QObject(parent), streamer(streamer)
+    {
+        timer.setTimerType(Qt::PreciseTimer);
+        timer.setInterval(5);
+        connect(&timer, &QTimer::timeout, this, &StreamRecordingPlayer::sendDuePackets);
+    }
+
+    /*! @brief Starts replaying filePath from startUs (relative to the first packet).
+    * @param rate Playback speed, 1.0 is real time. */
+    bool play(const QString& filePath, qint64 startUs = 0, double rate = 1.0) {
+        timer.stop();
+        if (rate <= 0 || !reader.open(filePath) || !reader.seek(reader.firstTimestampUs() + startUs)) {
+            return false;
+        }
+        playbackRate = rate;
+        hasPending = reader.readNext(pending);
+        if (!hasPending) {
+            return false;
+        }
+        baseTimestampUs = pending.timestampUs;
+        clock.start();
+        sendDuePackets();
+        timer.start();
+        return true;
+    }
+
+    void stop() {
+        timer.stop();
+    }
+
+signals:
+    void finished();
+
+private slots:
+    void sendDuePackets() {
+        const double recordingTimeUs = clock.nsecsElapsed() / 1000 * playbackRate;
+        while (hasPending && pending.timestampUs - baseTimestampUs <= recordingTimeUs) {
+            streamer->write(pending.payload);
+            hasPending = reader.readNext(pending);
+        }
+        if (!hasPending) {
+            timer.stop();
+            emit finished();
+        }
+    }
+
+private:
+    QSharedPointer<IStreamer> streamer;
+    StreamRecordingReader reader;
+    StreamRecordingReader::Packet pending;
+    bool hasPending = false;
+    qint64 baseTimestampUs = 0;
+    double playbackRate = 1.0;
+    QTimer timer;
+    QElapsedTimer clock;
+};
+
+#endif // STREAMRECORDING_H
@@ -0,0 +1,87 @@
+// VisualizationScheduler.h
+#ifndef VISUALIZATIONSCHEDULER_H
+#define VISUALIZATIONSCHEDULER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QQuickWindow>
+#include <atomic>
+#include <memory>
+#include "SpectrumFrame.h"
+
+/*! @brief Paces visualization updates to the display refresh.
+* The analysis thread may publish a frame for every captured chunk; the scheduler
+* takes only the newest one once per rendered frame (QQuickWindow::beforeRendering)
+* and delivers it on the GUI thread. Frames published in between are coalesced
+* by the triple buffer, so QML sees at most one update per vsync. */
+class VisualizationScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VisualizationScheduler(std::shared_ptr<SpectrumFrameBuffer> frameBuffer, QObject* parent = nullptr)
+        : QObject(parent), frameBuffer(std::move(frameBuffer))
+    {}
+
+    /*! @brief Ties the schedule to the render loop of the given window.
+    * Without a window every wake-up dispatches immediately. */
+    void attachWindow(QQuickWindow* newWindow) {
+        if (window) {
+            disconnect(window, &QQuickWindow::beforeRendering, this, &VisualizationScheduler::onBeforeRendering);
+        }
+        window = newWindow;
+        if (window) {
+            connect(window, &QQuickWindow::beforeRendering, this, &VisualizationScheduler::onBeforeRendering, Qt::DirectConnection);
+        }
+    }
+
+public slots:
+    /*! @brief Called by the producer after publishing a frame; safe from any thread.
+    * At most one wake-up is queued per rendered frame. */
+    void requestWake() {
+        if (!wakePending.exchange(true, std::memory_order_acq_rel)) {
+            QMetaObject::invokeMethod(this, &VisualizationScheduler::wake, Qt::QueuedConnection);
+        }
+    }
+
+signals:
+    /*! @brief Newest frame, emitted on the GUI thread at most once per rendered frame. */
+    void frameReady(const SpectrumFrame& frame);
+    void semitoneChanged(double semitone);
+
+private slots:
+    void wake() {
+        if (window) {
+            // Make sure a frame gets rendered; the render loop coalesces repeated requests
+            window->update();
+        } else {
+            wakePending.store(false, std::memory_order_release);
+            dispatch();
+        }
+    }
+
+    void dispatch() {
+        dispatchPending.store(false, std::memory_order_release);
+        if (!frameBuffer->update()) {
+            return;
+        }
+        const SpectrumFrame& frame = frameBuffer->readBuffer();
+        emit frameReady(frame);
+        emit semitoneChanged(frame.semitone);
+    }
+
+private:
+    /*! Runs on the scene graph render thread, once per frame. */
+    void onBeforeRendering() {
+        wakePending.store(false, std::memory_order_release);
+        if (frameBuffer->hasPending() && !dispatchPending.exchange(true, std::memory_order_acq_rel)) {
+            QMetaObject::invokeMethod(this, &VisualizationScheduler::dispatch, Qt::QueuedConnection);
+        }
+    }
+
+    std::shared_ptr<SpectrumFrameBuffer> frameBuffer;
+    QPointer<QQuickWindow> window;
+    std::atomic<bool> wakePending{false};
+    std::atomic<bool> dispatchPending{false};
+};
+
+#endif // VISUALIZATIONSCHEDULER_H
@@ -0,0 +1,239 @@
+// WavFileWriter.h
+#ifndef WAVFILEWRITER_H
+#define WAVFILEWRITER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include "SpscRingBuffer.h"
+
+/*! @brief PCM layout written into the WAV "fmt " chunk. */
+struct WavFormat
+{
+    uint32_t sampleRate = 44100;
+    uint16_t channelCount = 1;
+    uint16_t bitsPerSample = 16;
+};
+
+/*! @brief Streams PCM into a WAV file with constant memory use.
+* A provisional RIFF header is written on open(). write() only copies into a
+* lock-free ring, so it is safe to call from the capture thread; a background thread
+* drains the ring into a page-aligned block buffer, writes whole blocks at block-aligned
+* offsets and keeps the file preallocated ahead of the write position. close() flushes
+* the tail, patches the RIFF and data chunk sizes and trims the preallocation.
+* RIFF sizes are 32-bit, so sizes of recordings longer than 4 GiB are clamped. */
+class StreamingWavWriter
+{
+public:
+    static constexpr size_t HeaderSize = 44;
+    static constexpr size_t BlockSize = 1 << 20;
+    static constexpr off_t PreallocateSize = 16 << 20;
+
+    explicit StreamingWavWriter(size_t ringCapacity = 8 << 20)
+        : ring(ringCapacity)
+    {}
+    StreamingWavWriter(const StreamingWavWriter&) = delete;
+    StreamingWavWriter& operator=(const StreamingWavWriter&) = delete;
+    ~StreamingWavWriter() {
+        close();
+    }
+
+    /*! @brief Creates the file, writes a provisional header and starts the writer thread.
+    * @return True on success. */
+    bool open(const std::string& filePath, const WavFormat& wavFormat) {
+        close();
+        fd = ::open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        if (!block) {
+            block.reset(static_cast<char*>(std::aligned_alloc(4096, BlockSize)));
+        }
+        format = wavFormat;
+        fileOffset = 0;
+        preallocatedEnd = 0;
+        dataSize = 0;
+        dropped.store(0, std::memory_order_relaxed);
+        failed.store(false, std::memory_order_relaxed);
+        // The header is the start of the first block, so all block writes stay aligned
+        writeHeader(block.get(), 0);
+        blockFill = HeaderSize;
+        preallocate();
+        stopRequested = false;
+        writerThread = std::thread(&StreamingWavWriter::writerLoop, this);
+        return true;
+    }
+
+    /*! @brief Queues PCM bytes for writing; never blocks.
+    * @return Number of bytes accepted; the rest is counted in droppedBytes(). */
+    size_t write(const char* data, size_t size) {
+        const size_t accepted = ring.write(data, size);
+        if (accepted < size) {
+            dropped.fetch_add(size - accepted, std::memory_order_relaxed);
+        }
+        return accepted;
+    }
+
+    /*! @brief Flushes all queued data, finalizes the header and closes the file.
+    * @return True if every write succeeded. */
+    bool close() {
+        if (fd < 0) {
+            return true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopRequested = true;
+        }
+        wakeCondition.notify_one();
+        writerThread.join();
+
+        drain();
+        if (blockFill > 0) {
+            writeBlock(blockFill);
+        }
+        const uint64_t fileSize = fileOffset;
+        patchHeader();
+        if (ftruncate(fd, static_cast<off_t>(fileSize)) != 0) {
+            failed.store(true, std::memory_order_relaxed);
+        }
+        ::close(fd);
+        fd = -1;
+        return !failed.load(std::memory_order_relaxed);
+    }
+
+    bool isOpen() const {
+        return fd >= 0;
+    }
+
+    /*! @brief Bytes rejected by write() because the writer thread fell behind. */
+    uint64_t droppedBytes() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct FreeDeleter {
+        void operator()(char* p) const { std::free(p); }
+    };
+
+    static void putLe16(char* dst, uint16_t value) {
+        dst[0] = static_cast<char>(value & 0xff);
+        dst[1] = static_cast<char>(value >> 8);
+    }
+
+    static void putLe32(char* dst, uint32_t value) {
+        putLe16(dst, static_cast<uint16_t>(value & 0xffff));
+        putLe16(dst + 2, static_cast<uint16_t>(value >> 16));
+    }
+
+    void writeHeader(char* dst, uint64_t pcmSize) const {
+        const uint32_t clampedSize = static_cast<uint32_t>(
+            std::min<uint64_t>(pcmSize, std::numeric_limits<uint32_t>::max() - (HeaderSize - 8)));
+        const uint16_t blockAlign = format.channelCount * format.bitsPerSample / 8;
+        std::memcpy(dst, "RIFF", 4);
+        putLe32(dst + 4, clampedSize + HeaderSize - 8);
+        std::memcpy(dst + 8, "WAVE", 4);
+        std::memcpy(dst + 12, "fmt ", 4);
+        putLe32(dst + 16, 16);
+        putLe16(dst + 20, 1); // PCM
+        putLe16(dst + 22, format.channelCount);
+        putLe32(dst + 24, format.sampleRate);
+        putLe32(dst + 28, format.sampleRate * blockAlign);
+        putLe16(dst + 32, blockAlign);
+        putLe16(dst + 34, format.bitsPerSample);
+        std::memcpy(dst + 36, "data", 4);
+        putLe32(dst + 40, clampedSize);
+    }
+
+    void patchHeader() {
+        char header[HeaderSize];
+        writeHeader(header, dataSize);
+        if (pwrite(fd, header, HeaderSize, 0) != static_cast<ssize_t>(HeaderSize)) {
+            failed.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    /*! Reserves disk space ahead of the write position without changing the file size. */
+    void preallocate() {
+        if (static_cast<off_t>(fileOffset + BlockSize) <= preallocatedEnd) {
+            return;
+        }
+        if (fallocate(fd, FALLOC_FL_KEEP_SIZE, preallocatedEnd, PreallocateSize) == 0) {
+            preallocatedEnd += PreallocateSize;
+        } else {
+            // Not supported by the file system; plain writes still work
+            preallocatedEnd = std::numeric_limits<off_t>::max();
+        }
+    }
+
+    void writeBlock(size_t size) {
+        preallocate();
+        size_t written = 0;
+        while (written < size) {
+            const ssize_t rc = pwrite(fd, block.get() + written, size - written, static_cast<off_t>(fileOffset + written));
+            if (rc <= 0) {
+                if (rc < 0 && errno == EINTR) {
+                    continue;
+                }
+                failed.store(true, std::memory_order_relaxed);
+                break;
+            }
+            written += static_cast<size_t>(rc);
+        }
+        fileOffset += size;
+        blockFill = 0;
+    }
+
+    /*! Moves everything queued in the ring into the block buffer, writing full blocks. */
+    void drain() {
+        while (true) {
+            const size_t count = ring.read(block.get() + blockFill, BlockSize - blockFill);
+            if (count == 0) {
+                return;
+            }
+            blockFill += count;
+            dataSize += count;
+            if (blockFill == BlockSize) {
+                writeBlock(BlockSize);
+            }
+        }
+    }
+
+    void writerLoop() {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        while (!stopRequested) {
+            // The producer never signals; polling keeps write() free of any locking
+            wakeCondition.wait_for(lock, std::chrono::milliseconds(50));
+            lock.unlock();
+            drain();
+            lock.lock();
+        }
+    }
+
+    SpscRingBuffer ring;
+    std::unique_ptr<char, FreeDeleter> block;
+    size_t blockFill = 0;
+    int fd = -1;
+    WavFormat format;
+    uint64_t fileOffset = 0;
+    uint64_t dataSize = 0;
+    off_t preallocatedEnd = 0;
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> failed{false};
+    std::thread writerThread;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    bool stopRequested = false;
+};
+
+#endif // WAVFILEWRITER_H
@@ -2,16 +2,76 @@
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
+#include <QQuickWindow>
+#include <QCommandLineParser>
+#include <QUdpSocket>
 #include "AudioServiceFactory.h"
 #include "AudioProcessor.h"
 #include "AudioCapture.h"
 #include "SpectrumVisualizer.h"
 #include "AudioService.h"
 #include "AudioStreamer.h"
+#include "StreamRecording.h"
+
+// Parses group:port, as given to --stream
+static bool parseStreamEndpoint(const QString& value, QHostAddress& group, quint16& port) {
+    const QStringList address = value.split(':');
+    bool portOk = false;
+    group = QHostAddress(address.value(0));
+    port = static_cast<quint16>(address.value(1).toUInt(&portOk));
+    return address.size() == 2 && group.isMulticast() && portOk && port != 0;
+}
 
 int main(int argc, char *argv[]) {
     QGuiApplication app(argc, argv);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption streamOption("stream", "Multicast stream group:port to record or replay on (default 239.255.31.1:3101).", "endpoint", "239.255.31.1:3101");
+    QCommandLineOption recordOption("record", "Record the multicast stream into a seekable recording.", "path");
+    QCommandLineOption replayOption("replay", "Replay a recording onto the multicast stream.", "path");
+    QCommandLineOption replayFromOption("replay-from", "Position to start the replay at, in seconds (default 0).", "seconds", "0");
+    QCommandLineOption replayRateOption("replay-rate", "Replay speed, 1 is real time (default 1).", "rate", "1");
+    parser.addOption(streamOption);
+    parser.addOption(recordOption);
+    parser.addOption(replayOption);
+    parser.addOption(replayFromOption);
+    parser.addOption(replayRateOption);
+    parser.process(app);
+
+    // Record and replay share one socket joined to the stream
+    QSharedPointer<QUdpSocket> streamSocket;
+    QSharedPointer<IStreamer> streamer;
+    StreamRecordingWriter recorder;
+    QSharedPointer<StreamRecordingPlayer> player;
+    if (parser.isSet(recordOption) || parser.isSet(replayOption)) {
+        QHostAddress group;
+        quint16 port = 0;
+        if (!parseStreamEndpoint(parser.value(streamOption), group, port)) {
+            qWarning() << "--stream needs a multicast group:port";
+        } else {
+            streamSocket = QSharedPointer<QUdpSocket>::create();
+            streamer = UdpStreamerFactory(group, port).create(streamSocket);
+        }
+    }
+    if (streamer && parser.isSet(recordOption)) {
+        if (recorder.open(parser.value(recordOption))) {
+            // read() emits datagramReceived per datagram, which keeps the packet boundaries
+            QObject::connect(streamSocket.data(), &QUdpSocket::readyRead, streamer.data(), [streamer]() { streamer->read(); });
+            QObject::connect(qSharedPointerCast<UdpStreamer>(streamer).data(), &UdpStreamer::datagramReceived, &recorder, &StreamRecordingWriter::appendPacket);
+        } else {
+            qWarning() << "Can not record to" << parser.value(recordOption);
+        }
+    }
+    if (streamer && parser.isSet(replayOption)) {
+        player = QSharedPointer<StreamRecordingPlayer>::create(streamer);
+        QObject::connect(player.data(), &StreamRecordingPlayer::finished, []() { qDebug() << "Replay finished"; });
+        const qint64 replayFromUs = static_cast<qint64>(parser.value(replayFromOption).toDouble() * 1000000);
+        if (!player->play(parser.value(replayOption), replayFromUs, parser.value(replayRateOption).toDouble())) {
+            qWarning() << "Can not replay" << parser.value(replayOption);
+        }
+    }
+
     // Create instances of the components
     AudioProcessor audioProcessor;
     VisualizerQml visualizerQml;
@@ -21,7 +81,7 @@ int main(int argc, char *argv[]) {
 
     // Connect the observer to the controller
     QObject::connect(&controller, &AudioColorProvider::audioDataReady, &controller, &AudioColorProvider::readAudioData);
-    QObject::connect(&controller, &AudioColorProvider::semitoneChanged, &visualizerQml, &VisualizerQml::updateVisualization);
+    QObject::connect(&controller, &AudioColorProvider::frameReady, &SpectrumVisualizer::getInstance(), &SpectrumVisualizer::setFrame);
 
     // Register AudioService and AudioColorProvider types
     qmlRegisterType<AudioService>("MelodyColor", 1, 0, "AudioService");
@@ -37,5 +97,8 @@ int main(int argc, char *argv[]) {
     if (engine.rootObjects().isEmpty())
         return -1;
 
+    // Deliver visualization updates once per rendered frame
+    controller.attachWindow(qobject_cast<QQuickWindow*>(engine.rootObjects().first()));
+
     return app.exec();
 }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <QDataStream>
 #include <QDebug>
 #include <QIODevice>
@@ -14,6 +15,9 @@ QSharedPointer<Message> MessageSerial::read(QSharedPointer<QByteArray> bytes)
         return nullptr;
     MessageType type;
     stream >> type;
+    quint32 requestId = 0;
+    if (isControlMessage(type))
+        stream >> requestId;
     if (stream.status() != QDataStream::Ok)
         return nullptr;
 
@@ -23,42 +27,67 @@ QSharedPointer<Message> MessageSerial::read(QSharedPointer<QByteArray> bytes)
     {
         SsrcId ssrcId;
         int32_t svcAnnouncesSize;
-        stream >> svcAnnouncesSize;
-        std::vector<ServiceType> svcAnnounces;
-        svcAnnounces.reserve(svcAnnouncesSize);
-        stream >> ssrcId;
+        stream >> ssrcId >> svcAnnouncesSize;
+        if (stream.status() != QDataStream::Ok || svcAnnouncesSize < 0 || svcAnnouncesSize > 64)
+            return nullptr;
+        std::vector<ServiceType> svcAnnounces(svcAnnouncesSize);
         for (auto& item : svcAnnounces) {
             stream >> item;
         }
-        QSharedPointer<IMessageData> messageDataPtr = QSharedPointer<IMessageData>::create(PeerDiscoveryRequest(ssrcId, svcAnnounces));
+        int32_t knownAnswersSize = 0;
+        // Requests of older peers end here
+        if (!stream.atEnd())
+            stream >> knownAnswersSize;
+        if (stream.status() != QDataStream::Ok || knownAnswersSize < 0 || knownAnswersSize > PeerDiscoveryRequest::maxKnownAnswers)
+            return nullptr;
+        std::vector<SsrcId> knownAnswers(knownAnswersSize);
+        for (auto& item : knownAnswers) {
+            stream >> item;
+        }
+        if (stream.status() != QDataStream::Ok)
+            return nullptr;
+        QSharedPointer<IMessageData> messageDataPtr = QSharedPointer<PeerDiscoveryRequest>::create(ssrcId, svcAnnounces, knownAnswers);
         return QSharedPointer<Message>::create(type, messageDataPtr);
     }
     case MessageType::PeerDiscoveryResponse:
     {
         SsrcId ssrcId;
         stream >> ssrcId;
-        QSharedPointer<IMessageData> messageDataPtr = QSharedPointer<IMessageData>::create(PeerDiscoveryResponse(ssrcId));
+        if (stream.status() != QDataStream::Ok)
+            return nullptr;
+        // Created as the derived type, dynamicCast<PeerDiscoveryResponse>() must find it
+        QSharedPointer<IMessageData> messageDataPtr = QSharedPointer<PeerDiscoveryResponse>::create(ssrcId);
         return QSharedPointer<Message>::create(type, messageDataPtr);
     }
     case MessageType::DeviceInfoRequest:
     {
         SsrcId ssrcId;
         stream >> ssrcId;
-        QSharedPointer<IMessageData> messageDataPtr = QSharedPointer<IMessageData>::create(DeviceInfoRequest(ssrcId));
-        return QSharedPointer<Message>::create(type, messageDataPtr);
+        if (stream.status() != QDataStream::Ok)
+            return nullptr;
+        QSharedPointer<IMessageData> messageDataPtr = QSharedPointer<DeviceInfoRequest>::create(ssrcId);
+        auto message = QSharedPointer<Message>::create(type, messageDataPtr);
+        message->setRequestId(requestId);
+        return message;
     }
     case MessageType::DeviceInfoResponse:
     {
         DeviceType deviceType;
         stream >> deviceType;
-        int32_t deviceHardwareSize;
+        int32_t deviceHardwareSize = 0;
         stream >> deviceHardwareSize;
-        std::vector<HardwareType> deviceHardware{HardwareType::Unknown, deviceHardwareSize};
+        if (stream.status() != QDataStream::Ok || deviceHardwareSize < 0 || deviceHardwareSize > 64)
+            return nullptr;
+        std::vector<HardwareType> deviceHardware(deviceHardwareSize, HardwareType::Unknown);
         for (auto& item : deviceHardware) {
             stream >> item;
         }
-        QSharedPointer<IMessageData> messageDataPtr = QSharedPointer<IMessageData>::create(DeviceInfoResponse(deviceType, deviceHardware));
-        return QSharedPointer<Message>::create(type, messageDataPtr);
+        if (stream.status() != QDataStream::Ok)
+            return nullptr;
+        QSharedPointer<IMessageData> messageDataPtr = QSharedPointer<DeviceInfoResponse>::create(deviceType, deviceHardware);
+        auto message = QSharedPointer<Message>::create(type, messageDataPtr);
+        message->setRequestId(requestId);
+        return message;
     }
     case MessageType::StartAudioStreamRequest:
     case MessageType::StartAudioStreamResponse:
@@ -66,9 +95,14 @@ QSharedPointer<Message> MessageSerial::read(QSharedPointer<QByteArray> bytes)
     case MessageType::StopAudioStreamResponse:
     {
         quint16 port;
-        stream >> port;
-        auto audioMsg = QSharedPointer<AudioMessage>(port);
-        return QSharedPointer<Message>(type, audioMsg);
+        SsrcId ssrcId;
+        stream >> port >> ssrcId;
+        if (stream.status() != QDataStream::Ok)
+            return nullptr;
+        auto audioMsg = QSharedPointer<AudioMessage>::create(port, ssrcId);
+        auto message = QSharedPointer<Message>::create(type, audioMsg.staticCast<IMessageData>());
+        message->setRequestId(requestId);
+        return message;
     }
     default:
         return nullptr;
@@ -80,6 +114,8 @@ QSharedPointer<QByteArray> MessageSerial::write(QSharedPointer<Message> message)
     auto bytes = QSharedPointer<QByteArray>(new QByteArray());
     QDataStream stream(bytes.get(), QIODevice::WriteOnly);
     stream << message->getType();
+    if (isControlMessage(message->getType()))
+        stream << message->getRequestId();
     switch (message->getType())
     {
     case MessageType::PeerDiscoveryRequest:
@@ -90,6 +126,11 @@ QSharedPointer<QByteArray> MessageSerial::write(QSharedPointer<Message> message)
         for (const auto& item : data->svcAnnounces) {
             stream << item;
         }
+        const auto knownAnswersSize = std::min<size_t>(data->knownAnswers.size(), PeerDiscoveryRequest::maxKnownAnswers);
+        stream << static_cast<int32_t>(knownAnswersSize);
+        for (size_t i = 0; i < knownAnswersSize; i++) {
+            stream << data->knownAnswers[i];
+        }
         break;
     }
     case MessageType::PeerDiscoveryResponse:
@@ -121,7 +162,7 @@ QSharedPointer<QByteArray> MessageSerial::write(QSharedPointer<Message> message)
     {
         const auto& audioMsg = message->getData().dynamicCast<AudioMessage>();
         if (audioMsg) {
-            stream << audioMsg->port;
+            stream << audioMsg->port << audioMsg->ssrcId;
         }
         break;
     }
@@ -44,6 +44,20 @@ enum class ServiceType {
     Repeater = 4,
 };
 
+/** @return True for messages exchanged through ControlChannel, which carry a request ID. */
+inline bool isControlMessage(MessageType type)
+{
+    return type >= MessageType::DeviceInfoRequest && type <= MessageType::StopAudioStreamResponse;
+}
+
+/** @return True for the request half of a control exchange, false for its response. */
+inline bool isControlRequest(MessageType type)
+{
+    return type == MessageType::DeviceInfoRequest
+        || type == MessageType::StartAudioStreamRequest
+        || type == MessageType::StopAudioStreamRequest;
+}
+
 class IMessageData
 {
 public:
@@ -53,12 +67,18 @@ public:
 class PeerDiscoveryRequest: public IMessageData
 {
 public:
-    explicit PeerDiscoveryRequest(SsrcId ssrcId, std::vector<ServiceType> svcAnnounces): ssrcId(ssrcId), svcAnnounces(svcAnnounces)
+    // Upper bound of knownAnswers, keeps a request within one datagram
+    static constexpr int32_t maxKnownAnswers = 256;
+
+    explicit PeerDiscoveryRequest(SsrcId ssrcId, std::vector<ServiceType> svcAnnounces, std::vector<SsrcId> knownAnswers = {})
+        : ssrcId(ssrcId), svcAnnounces(svcAnnounces), knownAnswers(knownAnswers)
     {}
     virtual ~PeerDiscoveryRequest() override = default;
     SsrcId ssrcId;
     size_t svcAnnouncesSize() { return svcAnnounces.size(); }
     std::vector<ServiceType> svcAnnounces;
+    // Peers the sender already knows; they do not answer the request
+    std::vector<SsrcId> knownAnswers;
 };
 
 class PeerDiscoveryResponse : public IMessageData
@@ -92,9 +112,10 @@ public:
 
 class AudioMessage : public IMessageData {
 public:
-    explicit AudioMessage(quint16 port = 3101 /* TODO: temporary static value for port */): port(port) {}
+    explicit AudioMessage(quint16 port = 3101 /* TODO: temporary static value for port */, SsrcId ssrcId = 0): port(port), ssrcId(ssrcId) {}
     virtual ~AudioMessage() = default;
     quint16 port;
+    SsrcId ssrcId; // Stream owner, a port carries one SSRC at a time
 };
 
 class Message
@@ -109,9 +130,13 @@ public:
     virtual ~Message() = default;
     MessageType getType() const { return type; }
     QSharedPointer<IMessageData> getData() const { return data; }
+    /** @brief Pairs a control response with its request, 0 for messages that are not control messages. */
+    quint32 getRequestId() const { return requestId; }
+    void setRequestId(quint32 id) { requestId = id; }
 protected:
     MessageType type;
     QSharedPointer<IMessageData> data;
+    quint32 requestId = 0;
 };
 // MessageSerial is providing serialization of outgoing messages and deserialization of incoming messages.
 class MessageSerial
@@ -0,0 +1,370 @@
+// NetworkEngine.cpp
+#include <QDebug>
+#include <QMutexLocker>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "NetworkEngine.h"
+#ifdef BLUELINE_WITH_IO_URING
+#include "IoUringBackend.h"
+#else
+// Never instantiated, only completes the type for std::unique_ptr
+class IoUringBackend {};
+#endif
+
+NetworkEngine::Backend NetworkEngine::preferredBackend()
+{
+    return qEnvironmentVariable("BLUELINE_NET_BACKEND") == QLatin1String("io_uring") ? Backend::IoUring : Backend::Epoll;
+}
+
+NetworkEngine::NetworkEngine(Backend preferred)
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        qWarning() << "NetworkEngine - Failed to create epoll or eventfd:" << strerror(errno);
+        return;
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    if (preferred == Backend::IoUring) {
+#ifdef BLUELINE_WITH_IO_URING
+        uring = IoUringBackend::create(wakeFd);
+#endif
+        if (!uring) {
+            qWarning() << "NetworkEngine - io_uring unavailable, using epoll";
+        }
+    }
+}
+
+NetworkEngine::~NetworkEngine()
+{
+    stop();
+    // Sockets still registered, or still waiting to be
+    for (const auto& [fd, handler] : handlers) {
+        close(fd);
+    }
+    for (const Command& command : commands) {
+        if (command.type == Command::Add) {
+            close(command.fd);
+        }
+    }
+    if (wakeFd >= 0) {
+        close(wakeFd);
+    }
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+}
+
+NetworkEngine::Backend NetworkEngine::backend() const
+{
+    return uring ? Backend::IoUring : Backend::Epoll;
+}
+
+quint64 NetworkEngine::droppedSends() const
+{
+    quint64 drops = sendDrops.load(std::memory_order_relaxed);
+#ifdef BLUELINE_WITH_IO_URING
+    if (uring) {
+        drops += uring->failedSends();
+    }
+#endif
+    return drops;
+}
+
+bool NetworkEngine::start()
+{
+    if (thread) {
+        return true;
+    }
+    if (epollFd < 0 || wakeFd < 0) {
+        return false;
+    }
+    stopping = false;
+    buffers.resize(batchSize * datagramSize);
+    thread = QThread::create([this]() { run(); });
+    thread->setObjectName("NetworkEngine");
+    thread->start(QThread::TimeCriticalPriority);
+    return true;
+}
+
+void NetworkEngine::stop()
+{
+    if (!thread) {
+        return;
+    }
+    stopping = true;
+    wake();
+    thread->wait();
+    delete thread;
+    thread = nullptr;
+}
+
+int NetworkEngine::openUdp(const QHostAddress& address, quint16 port, ReceiveHandler handler, bool reusePort)
+{
+    sockaddr_storage storage;
+    socklen_t length;
+    if (!toSockaddr(address, port, storage, length)) {
+        return -1;
+    }
+    const int fd = socket(storage.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        qWarning() << "NetworkEngine - Failed to create socket:" << strerror(errno);
+        return -1;
+    }
+    const int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (reusePort) {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    }
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&storage), length) < 0) {
+        qWarning() << "NetworkEngine - Failed to bind" << address << port << ":" << strerror(errno);
+        close(fd);
+        return -1;
+    }
+    {
+        QMutexLocker locker(&commandsMutex);
+        commands.push_back({ Command::Add, fd, std::move(handler) });
+    }
+    wake();
+    return fd;
+}
+
+void NetworkEngine::closeSocket(int socketId)
+{
+    {
+        QMutexLocker locker(&commandsMutex);
+        commands.push_back({ Command::Remove, socketId, nullptr });
+    }
+    wake();
+}
+
+bool NetworkEngine::send(int socketId, const char* data, size_t size, const QHostAddress& receiver, quint16 receiverPort)
+{
+    sockaddr_storage storage;
+    socklen_t length;
+    if (!toSockaddr(receiver, receiverPort, storage, length)) {
+        return false;
+    }
+#ifdef BLUELINE_WITH_IO_URING
+    if (uring) {
+        if (!uring->queueSend(socketId, data, size, storage, length)) {
+            sendDrops.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+#endif
+    while (sendto(socketId, data, size, MSG_DONTWAIT, reinterpret_cast<const sockaddr*>(&storage), length) < 0) {
+        if (errno == EINTR) {
+            continue;
+        }
+        // A full send buffer drops the datagram, like a congested link would
+        sendDrops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool NetworkEngine::setMulticastOptions(int socketId, const QNetworkInterface& iface, int ttl, bool loopback)
+{
+    if (iface.isValid()) {
+        ip_mreqn request{};
+        request.imr_ifindex = iface.index();
+        if (setsockopt(socketId, IPPROTO_IP, IP_MULTICAST_IF, &request, sizeof(request)) < 0) {
+            qWarning() << "NetworkEngine - Failed to set multicast interface" << iface.name() << ":" << strerror(errno);
+            return false;
+        }
+    }
+    const int loop = loopback ? 1 : 0;
+    if (setsockopt(socketId, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0
+        || setsockopt(socketId, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0) {
+        qWarning() << "NetworkEngine - Failed to set multicast options:" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool NetworkEngine::enableBroadcast(int socketId)
+{
+    const int on = 1;
+    if (setsockopt(socketId, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on)) < 0) {
+        qWarning() << "NetworkEngine - Failed to enable broadcast:" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+void NetworkEngine::wake()
+{
+    const uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        qWarning() << "NetworkEngine - Failed to wake engine thread:" << strerror(errno);
+    }
+}
+
+void NetworkEngine::run()
+{
+    runCommands();
+#ifdef BLUELINE_WITH_IO_URING
+    if (uring) {
+        uring->run(stopping, [this]() {
+            drainWake();
+            runCommands();
+        });
+        return;
+    }
+#endif
+    runEpoll();
+}
+
+void NetworkEngine::drainWake()
+{
+    uint64_t value;
+    while (read(wakeFd, &value, sizeof(value)) > 0) {}
+}
+
+void NetworkEngine::runEpoll()
+{
+    epoll_event events[64];
+    while (!stopping.load(std::memory_order_acquire)) {
+        const int count = epoll_wait(epollFd, events, 64, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qWarning() << "NetworkEngine - epoll_wait failed:" << strerror(errno);
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            const int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                drainWake();
+                runCommands();
+                continue;
+            }
+            // A socket removed by an earlier event of this batch
+            auto it = handlers.find(fd);
+            if (it != handlers.end()) {
+                drain(fd, it->second);
+            }
+        }
+    }
+}
+
+void NetworkEngine::runCommands()
+{
+    std::vector<Command> pending;
+    {
+        QMutexLocker locker(&commandsMutex);
+        pending.swap(commands);
+    }
+    for (Command& command : pending) {
+#ifdef BLUELINE_WITH_IO_URING
+        if (uring) {
+            if (command.type == Command::Add) {
+                // unordered_map nodes are stable, the backend keeps the pointer
+                auto& handler = handlers[command.fd] = std::move(command.handler);
+                uring->addSocket(command.fd, &handler);
+            } else if (handlers.count(command.fd)) {
+                // Closed by the backend once the pending receive is cancelled
+                uring->removeSocket(command.fd);
+                handlers.erase(command.fd);
+            }
+            continue;
+        }
+#endif
+        if (command.type == Command::Add) {
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLET;
+            event.data.fd = command.fd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, command.fd, &event) < 0) {
+                qWarning() << "NetworkEngine - Failed to register socket:" << strerror(errno);
+                close(command.fd);
+                continue;
+            }
+            handlers[command.fd] = std::move(command.handler);
+            // Edge triggered: datagrams that arrived before registration raise no event
+            drain(command.fd, handlers[command.fd]);
+        } else if (handlers.erase(command.fd) > 0) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, command.fd, nullptr);
+            close(command.fd);
+        }
+    }
+}
+
+void NetworkEngine::drain(int fd, const ReceiveHandler& handler)
+{
+    mmsghdr msgs[batchSize];
+    iovec iovecs[batchSize];
+    sockaddr_storage senders[batchSize];
+    while (true) {
+        for (int i = 0; i < batchSize; i++) {
+            iovecs[i] = { buffers.data() + i * datagramSize, datagramSize };
+            std::memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &senders[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+        }
+        const int count = recvmmsg(fd, msgs, batchSize, MSG_DONTWAIT, nullptr);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return; // EAGAIN: drained
+        }
+        for (int i = 0; i < count; i++) {
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                continue;
+            }
+            quint16 senderPort = 0;
+            const QHostAddress sender = fromSockaddr(senders[i], &senderPort);
+            handler(buffers.data() + i * datagramSize, msgs[i].msg_len, sender, senderPort);
+        }
+        // A short batch emptied the queue; anything arriving later raises a new edge
+        if (count < batchSize) {
+            return;
+        }
+    }
+}
+
+bool NetworkEngine::toSockaddr(const QHostAddress& address, quint16 port, sockaddr_storage& storage, socklen_t& length)
+{
+    std::memset(&storage, 0, sizeof(storage));
+    if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+        auto* in = reinterpret_cast<sockaddr_in*>(&storage);
+        in->sin_family = AF_INET;
+        in->sin_port = htons(port);
+        in->sin_addr.s_addr = htonl(address.toIPv4Address());
+        length = sizeof(sockaddr_in);
+        return true;
+    }
+    // QHostAddress::Any binds dual stack
+    if (address.protocol() == QAbstractSocket::IPv6Protocol || address == QHostAddress::Any) {
+        auto* in6 = reinterpret_cast<sockaddr_in6*>(&storage);
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        const Q_IPV6ADDR ip6 = address.toIPv6Address();
+        std::memcpy(&in6->sin6_addr, ip6.c, sizeof(in6->sin6_addr));
+        length = sizeof(sockaddr_in6);
+        return true;
+    }
+    return false;
+}
+
+QHostAddress NetworkEngine::fromSockaddr(const sockaddr_storage& storage, quint16* port)
+{
+    const QHostAddress address(reinterpret_cast<const sockaddr*>(&storage));
+    if (port) {
+        *port = storage.ss_family == AF_INET6 ? ntohs(reinterpret_cast<const sockaddr_in6*>(&storage)->sin6_port)
+                                              : ntohs(reinterpret_cast<const sockaddr_in*>(&storage)->sin_port);
+    }
+    return address;
+}
@@ -0,0 +1,107 @@
+// NetworkEngine.h
+#ifndef NETWORKENGINE_H
+#define NETWORKENGINE_H
+#include <QHostAddress>
+#include <QMutex>
+#include <QNetworkInterface>
+#include <QThread>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <sys/socket.h>
+
+class IoUringBackend;
+
+/**
+ * @brief Network I/O on a thread of its own, independent of the Qt event loop.
+ *
+ * Owns raw non-blocking UDP sockets registered edge-triggered in one epoll instance. On
+ * readiness a socket is drained with recvmmsg until EAGAIN and each datagram is handed to
+ * the handler of the socket, on the engine thread. Handlers that need the GUI thread post
+ * to it themselves, so a stalled GUI only delays delivery, the kernel buffers never fill.
+ *
+ * openUdp(), closeSocket() and send() may be called from any thread: sockets are created
+ * by the caller and registered by the engine thread through a command queue and an eventfd,
+ * sends go straight to sendto() which is atomic per datagram.
+ *
+ * With the io_uring backend (built with BLUELINE_WITH_IO_URING) the same API is served by
+ * multishot receives into a provided buffer ring and batched sendmsg submissions, see
+ * IoUringBackend. It is chosen at construction and falls back to epoll where the kernel
+ * lacks support.
+ */
+class NetworkEngine
+{
+public:
+    /** @brief Called on the engine thread; data is only valid during the call. */
+    using ReceiveHandler = std::function<void(const char* data, size_t size, const QHostAddress& sender, quint16 senderPort)>;
+
+    enum class Backend { Epoll, IoUring };
+
+    /** @brief Backend named by the BLUELINE_NET_BACKEND environment variable ("epoll" or "io_uring"), epoll by default. */
+    static Backend preferredBackend();
+
+    explicit NetworkEngine(Backend preferred = Backend::Epoll);
+    virtual ~NetworkEngine();
+    NetworkEngine(const NetworkEngine&) = delete;
+    NetworkEngine& operator=(const NetworkEngine&) = delete;
+
+    bool start();
+    void stop();
+    bool isRunning() const { return thread != nullptr; }
+    /** @brief Backend actually in use, Epoll if io_uring was requested but is unavailable. */
+    Backend backend() const;
+
+    /** @brief Binds a UDP socket and starts delivering its datagrams to handler.
+     * @return Socket id, or -1 on failure. */
+    int openUdp(const QHostAddress& address, quint16 port, ReceiveHandler handler, bool reusePort = false);
+    /** @brief Stops delivering and closes the socket; the handler is not called afterwards. */
+    void closeSocket(int socketId);
+    /** @return False if the datagram was dropped, e.g. because the send buffer was full. */
+    bool send(int socketId, const char* data, size_t size, const QHostAddress& receiver, quint16 receiverPort);
+    /** @brief Sets the outgoing interface of IPv4 multicast (unless iface is invalid), its TTL and
+     * whether it loops back to local listeners. May be called from any thread. */
+    bool setMulticastOptions(int socketId, const QNetworkInterface& iface, int ttl, bool loopback);
+    /** @brief Allows sending to broadcast addresses. */
+    bool enableBroadcast(int socketId);
+
+    /** @brief Datagrams dropped by send() since start. */
+    quint64 droppedSends() const;
+
+    static bool toSockaddr(const QHostAddress& address, quint16 port, sockaddr_storage& storage, socklen_t& length);
+    static QHostAddress fromSockaddr(const sockaddr_storage& storage, quint16* port);
+
+private:
+    struct Command {
+        enum Type { Add, Remove } type;
+        int fd;
+        ReceiveHandler handler;
+    };
+
+    void run();
+    void runEpoll();
+    void drainWake();
+    void runCommands();
+    void drain(int fd, const ReceiveHandler& handler);
+    void wake();
+
+    int epollFd = -1;
+    int wakeFd = -1;
+    QThread* thread = nullptr;
+    std::unique_ptr<IoUringBackend> uring;
+    std::atomic<bool> stopping{false};
+    std::atomic<quint64> sendDrops{0};
+
+    QMutex commandsMutex;
+    std::vector<Command> commands;
+    // Engine thread only
+    std::unordered_map<int, ReceiveHandler> handlers;
+
+    // recvmmsg batch, engine thread only
+    static constexpr int batchSize = 32;
+    static constexpr int datagramSize = 2048;
+    std::vector<char> buffers;
+};
+
+#endif // NETWORKENGINE_H
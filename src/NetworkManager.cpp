@@ -1,29 +1,36 @@
 // NetworkManager.cpp
 #include <QDebug>
+#include <QNetworkDatagram>
 #include <QNetworkInterface>
 #include <QSharedPointer>
 #include <QRandomGenerator>
 #include "NetworkManager.h"
 
-QSharedPointer<Message> MsgQueue::get()
+QSharedPointer<Message> MsgQueue::get(QHostAddress* sender)
 {
     if (msgs.empty())
     {
         return nullptr;
     }
-    QSharedPointer<Message> msg = serial.read(msgs.front());
+    if (sender)
+    {
+        *sender = msgs.front().sender;
+    }
+    QSharedPointer<Message> msg = serial.read(msgs.front().bytes);
     msgs.pop_front();
     return msg;
 }
 
 void MsgQueueProcessor::processQueue()
 {
+    QHostAddress sender;
     while (!queue.empty())
     {
-        if (const auto& receivedMessage = queue.get(); receivedMessage)
+        if (const auto& receivedMessage = queue.get(&sender); receivedMessage)
         {
-            if (const auto& outgoingMessage = processMsg(receivedMessage); outgoingMessage)
+            if (const auto& outgoingMessage = processMsg(receivedMessage, sender); outgoingMessage)
             {
+                outgoingMessage->setRequestId(receivedMessage->getRequestId());
                 QSharedPointer<QByteArray> outgoingMessageBytes = serial.write(outgoingMessage);
                 emit outgoingMessageReady(outgoingMessageBytes);
             }
@@ -31,21 +38,25 @@ void MsgQueueProcessor::processQueue()
     }
 }
 
-QSharedPointer<Message> MsgQueueProcessor::processMsg(QSharedPointer<Message> message)
+QSharedPointer<Message> MsgQueueProcessor::processMsg(QSharedPointer<Message> message, const QHostAddress& sender)
 {
     switch (message->getType())
     {
     case MessageType::PeerDiscoveryRequest:
     {
         const auto& messageData = message->getData().dynamicCast<PeerDiscoveryRequest>();
-        emit peerDiscovered(messageData->ssrcId, messageData->svcAnnounces);
+        emit peerDiscovered(messageData->ssrcId, messageData->svcAnnounces, sender);
         const auto& responseMsg = QSharedPointer<PeerDiscoveryResponse>::create(localSsrcId);
         return responseMsg.staticCast<Message>();
     }
     case MessageType::PeerDiscoveryResponse:
     {
         const auto& messageData = message->getData().dynamicCast<PeerDiscoveryResponse>();
-        remoteSsrcIds.push_back(messageData->ssrcId); 
+        // Every peer answers every discovery round, only the first answer is news
+        if (!remoteSsrcIds.contains(messageData->ssrcId)) {
+            remoteSsrcIds.insert(messageData->ssrcId);
+            emit peerSsrcAnnounced(messageData->ssrcId, sender);
+        }
         return nullptr;
     }
     case MessageType::DeviceInfoRequest:
@@ -62,75 +73,257 @@ QSharedPointer<Message> MsgQueueProcessor::processMsg(QSharedPointer<Message> me
         return nullptr;
     }
     case MessageType::StartAudioStreamRequest:
-    case MessageType::StartAudioStreamResponse:
     {
         auto audioMessage = message->getData().dynamicCast<AudioMessage>();
-        if (audioMessage) {
-            emit processAudioMessage(audioMessage);
+        if (!audioMessage) {
+            return nullptr;
+        }
+        emit processAudioMessage(audioMessage, sender);
+        // The requester retransmits until it hears back
+        const auto& responseMsg = QSharedPointer<AudioMessage>::create(audioMessage->port, localSsrcId);
+        return QSharedPointer<Message>::create(MessageType::StartAudioStreamResponse, responseMsg.staticCast<IMessageData>());
+    }
+    case MessageType::StopAudioStreamRequest:
+    {
+        auto audioMessage = message->getData().dynamicCast<AudioMessage>();
+        if (!audioMessage) {
+            return nullptr;
         }
-        break;
+        // Directly connected, the session is closed before the acknowledgement goes out
+        emit stopAudioMessage(audioMessage, sender);
+        const auto& responseMsg = QSharedPointer<AudioMessage>::create(audioMessage->port, localSsrcId);
+        return QSharedPointer<Message>::create(MessageType::StopAudioStreamResponse, responseMsg.staticCast<IMessageData>());
     }
+    case MessageType::StartAudioStreamResponse:
+    case MessageType::StopAudioStreamResponse:
+        // Acknowledgements, matched to their request by NetworkManager::handleControlResponse;
+        // they must not open a session, the responder's SSRC does not own our port
+        return nullptr;
     default:
         return nullptr;
     }
 }
 
+static std::unique_ptr<NetworkEngine> startMediaEngine()
+{
+    auto engine = std::make_unique<NetworkEngine>(NetworkEngine::preferredBackend());
+    if (!engine->start()) {
+        qWarning() << "NetworkManager - Media engine unavailable, media sockets stay on the GUI thread";
+        return nullptr;
+    }
+    return engine;
+}
+
 NetworkManager::NetworkManager(QObject* parent)
     : QObject(parent)
+    , mediaEngine(startMediaEngine())
+    , interfaceMonitor(new InterfaceMonitor(this))
+    , audioServiceFactory(nullptr, QSharedPointer<AudioStreamer>(
+          AudioStreamerFactory(QHostAddress(defaultMediaGroup), defaultMediaPort, this, interfaceMonitor, mediaEngine.get()).create().release()))
 {
     ssrcId = QRandomGenerator::global()->generate();
     connect(&msgQueueProcessor, &MsgQueueProcessor::processAudioMessage, this, &NetworkManager::handleAudioMessage);
-    connect(&discoveryTimer, &QTimer::timeout, [&]() 
-    {
-        // Start listening on the interface socket for peer discovery
-        interfaceSocket->startListening(QHostAddress::AnyIPv4, 3103);
-        // Broadcast discovery message
-        interfaceSocket->getUdpSocket()->writeDatagram("Instance Discovery", QHostAddress::Broadcast, 3103);
-        // Stop listening and cleanup after the discovery timeout
-        QTimer::singleShot(2000, [&]() 
-        {
-            interfaceSocket->getUdpSocket()->disconnect();
-            interfaceSocket->getUdpSocket()->close();
-            interfaceSocket->disconnect();
-            interfaceSocket.clear();
-        });
-    });
+    connect(&msgQueueProcessor, &MsgQueueProcessor::stopAudioMessage, this, &NetworkManager::handleStopAudioMessage);
+    connect(&msgQueueProcessor, &MsgQueueProcessor::peerSsrcAnnounced, this, &NetworkManager::handlePeerSsrc);
+    discoveryEngine = new DiscoveryEngine(ssrcId, {}, DiscoveryEngine::defaultPort, this, mediaEngine.get());
+    connect(discoveryEngine, &DiscoveryEngine::peerDiscovered, this, &NetworkManager::handleDiscoveredPeer);
+    connect(discoveryEngine, &DiscoveryEngine::peerSeen, this, &NetworkManager::handlePeerSeen);
+    control = new ControlChannel(this);
+    connect(control, &ControlChannel::datagramReady, this, &NetworkManager::sendData);
+    connect(control, &ControlChannel::requestReceived, this, &NetworkManager::handleControlRequest);
+    connect(control, &ControlChannel::responseReceived, this, &NetworkManager::handleControlResponse);
+    connect(control, &ControlChannel::requestFailed, this, &NetworkManager::handleControlRequestFailed);
+    liveness = new PeerLiveness(DiscoveryEngine::peerTtlMs, this);
+    connect(liveness, &PeerLiveness::peerExpired, this, &NetworkManager::handlePeerExpired);
+    fanout = QSharedPointer<UnicastFanout>::create();
+    if (QSharedPointer<AudioStreamer> streamer = audioServiceFactory.getStreamer()) {
+        streamer->setFanout(fanout);
+    }
+    // Last, received datagrams may reach handleDataReceived from here on
+    if (!startNetworkEngine(defaultControlPort)) {
+        qWarning() << "NetworkManager - No control socket on port" << defaultControlPort;
+    }
 }
 
 NetworkManager::~NetworkManager()
 {
     stopDiscovery();
     stopAudioStreaming();
+    stopFileStreaming();
+    stopNetworkEngine();
+    stopRepeater();
 }
 
-void NetworkManager::startDiscovery()
+bool NetworkManager::startNetworkEngine(quint16 controlPort, int workers)
 {
-    if (!discoveryTimer->isActive()) {
-        discoveryTimer.start(5000);
+    if (controlShards || controlFallback) {
+        return true;
     }
+    controlShards = std::make_unique<ReceiveShardGroup>(workers, NetworkEngine::preferredBackend());
+    this->controlPort = controlPort;
+    // Runs on a worker thread: copy the datagram and hand it to the GUI thread
+    const bool opened = controlShards->open(QHostAddress::AnyIPv4, controlPort,
+        [this](int, const char* data, size_t size, const QHostAddress& sender, quint16 senderPort) {
+            QByteArray bytes(data, static_cast<qsizetype>(size));
+            QMetaObject::invokeMethod(this, [this, bytes, sender, senderPort]() {
+                handleDataReceived(bytes, sender, senderPort);
+            }, Qt::QueuedConnection);
+        });
+    if (opened) {
+        return true;
+    }
+    controlShards.reset();
+    qWarning() << "NetworkManager::startNetworkEngine - engine unavailable, control traffic stays on the GUI thread";
+    controlFallback = new QUdpSocket(this);
+    if (!controlFallback->bind(QHostAddress::AnyIPv4, controlPort)) {
+        qWarning() << "NetworkManager::startNetworkEngine - bind failed" << controlFallback->errorString();
+        delete controlFallback;
+        controlFallback = nullptr;
+        return false;
+    }
+    connect(controlFallback, &QUdpSocket::readyRead, this, &NetworkManager::readControlFallback);
+    return true;
 }
 
-void NetworkManager::stopDiscovery()
+void NetworkManager::stopNetworkEngine()
+{
+    // Joins the worker threads, no handler runs afterwards
+    controlShards.reset();
+    delete controlFallback;
+    controlFallback = nullptr;
+}
+
+void NetworkManager::readControlFallback()
 {
-    if (discoveryTimer.isActive()) {
-        discoveryTimer.stop();
+    while (controlFallback->hasPendingDatagrams()) {
+        QNetworkDatagram datagram = controlFallback->receiveDatagram();
+        handleDataReceived(datagram.data(), datagram.senderAddress(), static_cast<quint16>(datagram.senderPort()));
     }
 }
 
-void NetworkManager::connectToPeer(int index)
+bool NetworkManager::startRepeater(const RepeaterConfig& config)
 {
-    if (index >= 0 && index < peers.size()) {
-        QSharedPointer<NetworkPeer> peer = peers.at(index);
+    if (repeater) {
+        return true;
+    }
+    repeater = new RepeaterService(config);
+    // Seeded here, later changes are queued to repeaterThread by setUnicastSubscriber
+    repeaterFanout = QSharedPointer<UnicastFanout>::create();
+    peers.forEach([this](int index, const QSharedPointer<NetworkPeer>& peer) {
+        if (fanout->hasSubscriber(index)) {
+            repeaterFanout->addSubscriber(index, QHostAddress(peer->getPeerAddress()), defaultMediaPort);
+        }
+    });
+    repeater->setFanout(repeaterFanout);
+    repeater->moveToThread(&repeaterThread);
+    connect(&repeaterThread, &QThread::finished, repeater, &QObject::deleteLater);
+    repeaterThread.start(QThread::TimeCriticalPriority);
+    bool started = false;
+    QMetaObject::invokeMethod(repeater, &RepeaterService::start, Qt::BlockingQueuedConnection, &started);
+    if (!started) {
+        stopRepeater();
+        return false;
+    }
+    discoveryEngine->setServices({ ServiceType::Repeater });
+    return true;
+}
+
+void NetworkManager::stopRepeater()
+{
+    if (!repeater) {
+        return;
+    }
+    discoveryEngine->setServices({});
+    // finished deletes the repeater on its own thread
+    repeaterThread.quit();
+    repeaterThread.wait();
+    repeater = nullptr;
+    repeaterFanout.reset();
+}
+
+void NetworkManager::setUnicastSubscriber(int index, const QHostAddress& address, bool subscribed)
+{
+    if (subscribed) {
+        fanout->addSubscriber(index, address, defaultMediaPort);
+    } else {
+        fanout->removeSubscriber(index);
+    }
+    if (!repeater) {
+        return;
+    }
+    // UnicastFanout is not thread safe, the repeater's copy changes on its own thread
+    QSharedPointer<UnicastFanout> target = repeaterFanout;
+    QMetaObject::invokeMethod(repeater, [target, index, address, subscribed]() {
+        if (subscribed) {
+            target->addSubscriber(index, address, defaultMediaPort);
+        } else {
+            target->removeSubscriber(index);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void NetworkManager::sendData(QByteArray data, QHostAddress receiver, quint16 receiverPort)
+{
+    bool sent = false;
+    if (controlShards) {
+        sent = controlShards->engineOf(0).send(controlShards->socketOf(0), data.constData(), static_cast<size_t>(data.size()), receiver, receiverPort);
+    } else if (controlFallback) {
+        sent = controlFallback->writeDatagram(data, receiver, receiverPort) == data.size();
+    } else {
+        qWarning() << "NetworkManager::sendData - no control socket";
+        return;
+    }
+    // Requests are retransmitted by the control channel, a lost response by the requester
+    if (!sent) {
+        qWarning() << "NetworkManager::sendData - datagram to" << receiver << "dropped";
+    }
+}
+
+quint32 NetworkManager::sendControlRequest(int index, QSharedPointer<Message> request)
+{
+    QSharedPointer<NetworkPeer> peer = peers.at(index);
+    if (!peer) {
+        return 0;
+    }
+    return control->sendRequest(request, QHostAddress(peer->getPeerAddress()), controlPort);
+}
+
+void NetworkManager::requestAudioStreams(const QList<int>& indices, quint16 port)
+{
+    // All requests go out back to back, the responses arrive in about one round trip
+    for (int index : indices) {
+        auto request = QSharedPointer<AudioMessage>::create(port, ssrcId);
+        const quint32 requestId = sendControlRequest(index, QSharedPointer<Message>::create(MessageType::StartAudioStreamRequest, request.staticCast<IMessageData>()));
+        if (requestId) {
+            streamRequests.insert(requestId, index);
+        }
+    }
+}
+
+void NetworkManager::startDiscovery()
+{
+    discoveryEngine->start();
+}
+
+void NetworkManager::stopDiscovery()
+{
+    discoveryEngine->stop();
+}
+
+void NetworkManager::connectToPeer(int index, DeliveryMode mode)
+{
+    if (QSharedPointer<NetworkPeer> peer = peers.at(index)) {
         if (!peer->isConnected()) {
             peer->connectToPeer();
         }
+        setUnicastSubscriber(index, QHostAddress(peer->getPeerAddress()), mode == DeliveryMode::Unicast);
     }
 }
 
 void NetworkManager::disconnectFromPeer(int index)
 {
-    if (index >= 0 && index < peers.size()) {
-        QSharedPointer<NetworkPeer> peer = peers.at(index);
+    if (QSharedPointer<NetworkPeer> peer = peers.at(index)) {
+        setUnicastSubscriber(index, QHostAddress(), false);
         if (peer->isConnected()) {
             peer->disconnectFromPeer();
         }
@@ -139,50 +332,172 @@ void NetworkManager::disconnectFromPeer(int index)
 
 void NetworkManager::startAudioStreaming()
 {
-    for (const auto& peer : peers) {
+    QList<int> indices;
+    peers.forEach([&indices](int index, const QSharedPointer<NetworkPeer>& peer) {
         if (peer->isConnected()) {
             peer->startAudioStreaming();
+            indices.append(index);
         }
-    }
+    });
+    requestAudioStreams(indices);
 }
 
 void NetworkManager::stopAudioStreaming()
 {
-    for (const auto& peer : peers) {
+    peers.forEach([](int, const QSharedPointer<NetworkPeer>& peer) {
         if (peer->isConnected()) {
             peer->stopAudioStreaming();
         }
+    });
+}
+
+bool NetworkManager::startFileStreaming(const QString& path, const QAudioFormat& rawFormat, bool loop)
+{
+    QSharedPointer<AudioStreamer> streamer = audioServiceFactory.getStreamer();
+    if (!streamer) {
+        qWarning() << "NetworkManager::startFileStreaming - no streamer";
+        return false;
+    }
+    stopFileStreaming();
+    fileSource = FileAudioSourceFactory(path, 20, rawFormat).create(loop);
+    if (!fileSource) {
+        return false;
+    }
+    connect(fileSource.get(), &FileAudioSource::audioDataProvided, streamer.data(), &AudioStreamer::receiveAudioData);
+    connect(fileSource.get(), &FileAudioSource::finished, this, &NetworkManager::stopFileStreaming);
+    fileSource->start();
+    return true;
+}
+
+void NetworkManager::stopFileStreaming()
+{
+    if (fileSource) {
+        fileSource->stop();
+        // May be called from the source's own finished signal
+        fileSource.release()->deleteLater();
     }
 }
 
 void NetworkManager::handlePeerDiscovery(QString name, QString address)
 {
-    for (int i = 0; i < peers.size(); i++) {
-        QSharedPointer<NetworkPeer> peer = peers.at(i);
-        if (peer->getPeerAddress() == address) {
-            emit connectionStatusUpdated(i, peer->isConnected());
-            return;
-        }
+    const QHostAddress peerAddress(address);
+    if (int index = peers.indexOf(peerAddress); index >= 0) {
+        emit connectionStatusUpdated(index, peers.at(index)->isConnected());
+        return;
     }
 
     QSharedPointer<InterfaceSocket> interfaceSocket = audioServiceFactory.createInterfaceSocket(false);
     QSharedPointer<NetworkPeer> newPeer(new NetworkPeer(interfaceSocket, address));
-    peers.append(newPeer);
+    const int index = peers.insert(peerAddress, newPeer);
 
-    connect(newPeer.data(), &NetworkPeer::connectionStatusUpdated, [&](bool connected) {
-        int index = peers.indexOf(newPeer);
+    // The index stays valid for as long as the peer is registered
+    connect(newPeer.data(), &NetworkPeer::connectionStatusUpdated, this, [this, index](bool connected) {
         emit connectionStatusUpdated(index, connected);
     });
 
     emit peerDiscovered(name, address);
 }
 
+void NetworkManager::handleDiscoveredPeer(SsrcId ssrcId, std::vector<ServiceType> svcAnnounces, QHostAddress address)
+{
+    handlePeerDiscovery(QString::number(ssrcId), address.toString());
+    handlePeerSsrc(ssrcId, address);
+}
+
 void NetworkManager::handleDataReceived(QByteArray data, QHostAddress sender, quint16 senderPort)
 {
-    for (const auto& peer : peers) {
-        if (peer->getPeerAddress() == sender.toString()) {
-            peer->handleDataReceived(data);
-            return;
+    // RTP and RTCP traffic keeps a peer alive as well as discovery does
+    const int index = peers.indexOf(sender);
+    if (index >= 0) {
+        liveness->touch(index);
+    }
+    if (control->handleDatagram(data, sender, senderPort)) {
+        return;
+    }
+    if (index >= 0) {
+        peers.at(index)->handleDataReceived(data);
+    }
+}
+
+void NetworkManager::handleControlRequest(QSharedPointer<Message> request, QHostAddress sender, quint16 senderPort)
+{
+    if (const auto& response = msgQueueProcessor.processMsg(request, sender); response) {
+        control->sendResponse(request->getRequestId(), response, sender, senderPort);
+    }
+}
+
+void NetworkManager::handleControlResponse(quint32 requestId, QSharedPointer<Message> response, QHostAddress sender)
+{
+    // A stream response only acknowledges our request, the session lives on the responder
+    if (auto it = streamRequests.find(requestId); it != streamRequests.end()) {
+        const int index = it.value();
+        streamRequests.erase(it);
+        auto audioMessage = response->getData().dynamicCast<AudioMessage>();
+        if (audioMessage && response->getType() == MessageType::StartAudioStreamResponse) {
+            emit audioStreamAccepted(index, audioMessage->port);
         }
+        return;
+    }
+    msgQueueProcessor.processMsg(response, sender);
+}
+
+void NetworkManager::handleStopAudioMessage(QSharedPointer<AudioMessage> audioMessage, QHostAddress sender)
+{
+    const StreamSession* session = sessions.find(audioMessage->port);
+    if (!session) {
+        return; // already closed, the request is a retransmission
+    }
+    if (session->ssrcId != audioMessage->ssrcId) {
+        qWarning() << "NetworkManager - SSRC" << audioMessage->ssrcId << "can not stop port" << audioMessage->port
+                   << "of SSRC" << session->ssrcId;
+        return;
+    }
+    sessions.close(audioMessage->port);
+}
+
+void NetworkManager::handleControlRequestFailed(quint32 requestId, QHostAddress peer)
+{
+    streamRequests.remove(requestId);
+    const int index = peers.indexOf(peer);
+    if (index < 0) {
+        return; // expired meanwhile, already reported through peerExpired
+    }
+    emit controlRequestFailed(index, requestId);
+}
+
+void NetworkManager::handlePeerSsrc(SsrcId ssrcId, QHostAddress sender)
+{
+    peers.setSsrc(peers.indexOf(sender), ssrcId);
+}
+
+void NetworkManager::handlePeerSeen(SsrcId ssrcId, QHostAddress address)
+{
+    if (int index = peers.indexOf(address); index >= 0) {
+        liveness->touch(index);
+    }
+}
+
+void NetworkManager::handlePeerExpired(int index)
+{
+    QSharedPointer<NetworkPeer> peer = peers.at(index);
+    if (!peer) {
+        return;
+    }
+    qDebug() << "NetworkManager - Peer" << index << "expired";
+    peer->disconnect(this);
+    control->cancelRequests(QHostAddress(peer->getPeerAddress()));
+    // Cancelled requests are not reported, forget them here
+    streamRequests.removeIf([index](const QHash<quint32, int>::iterator& it) { return it.value() == index; });
+    setUnicastSubscriber(index, QHostAddress(), false);
+    if (peer->isConnected()) {
+        peer->disconnectFromPeer();
+    }
+    sessions.closePeer(index);
+    // Forget the SSRC everywhere so the peer is announced afresh if it comes back
+    if (std::optional<SsrcId> ssrcId = peers.ssrcOf(index)) {
+        discoveryEngine->forgetPeer(*ssrcId);
+        msgQueueProcessor.forgetSsrc(*ssrcId);
     }
+    peers.remove(index);
+    emit peerExpired(index);
 }
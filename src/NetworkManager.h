@@ -3,13 +3,25 @@
 #define NETWORKMANAGER_H
 #include <QObject>
 #include <QSharedPointer>
+#include <QHash>
 #include <QList>
 #include <QByteArray>
 #include <QIODevice>
-#include <QMap>
+#include <QDebug>
+#include <QSet>
+#include <QHostAddress>
+#include <QThread>
+#include <memory>
 #include "Message.h"
+#include "PeerRegistry.h"
 #include "AudioServiceFactory.h"
 #include "AudioService.h"
+#include "ControlChannel.h"
+#include "DiscoveryEngine.h"
+#include "PeerLiveness.h"
+#include "ReceiveShardGroup.h"
+#include "RepeaterService.h"
+#include "StreamSessionManager.h"
 
 class MsgQueue : public QObject
 {
@@ -18,15 +30,21 @@ class MsgQueue : public QObject
 public:
     MsgQueue(MessageSerial& serial) : serial(serial) {}
     virtual ~MsgQueue() = default;
-    void push(QSharedPointer<QByteArray> bytes) { 
-        msgs.push_back(bytes); 
+    void push(QSharedPointer<QByteArray> bytes, const QHostAddress& sender) { 
+        msgs.push_back({ bytes, sender }); 
     }
     bool empty() { 
         return msgs.empty();
     }
-    QSharedPointer<Message> get();
+    /** @brief Pops and deserializes the oldest message.
+     * @param sender If not null, receives the address the message came from. */
+    QSharedPointer<Message> get(QHostAddress* sender = nullptr);
 private:
-    std::list<QSharedPointer<QByteArray>> msgs;
+    struct QueuedMsg {
+        QSharedPointer<QByteArray> bytes;
+        QHostAddress sender;
+    };
+    std::list<QueuedMsg> msgs;
     MessageSerial& serial;
 };
 
@@ -41,15 +59,22 @@ public:
         connect(this, &MsgQueueProcessor::processAudioMessage, &audioService, &NetworkManager::handleAudioMessage);
     }
     void processQueue();
-    QSharedPointer<Message> processMsg(QSharedPointer<Message> message);
+    /** @brief Lets ssrcId be announced again, after its peer expired. */
+    void forgetSsrc(SsrcId ssrcId) { remoteSsrcIds.remove(ssrcId); }
+    QSharedPointer<Message> processMsg(QSharedPointer<Message> message, const QHostAddress& sender);
 signals:
-    void peerDiscovered(SsrcId ssrcId, std::vector<ServiceType> svcAnnounces);
+    void peerDiscovered(SsrcId ssrcId, std::vector<ServiceType> svcAnnounces, QHostAddress sender);
+    /** @brief Emitted once per remote SSRC, the first time a discovery response announces it. */
+    void peerSsrcAnnounced(SsrcId ssrcId, QHostAddress sender);
     void audioMessageReady(QSharedPointer<AudioMessage> outgoingMessageBytes);
-    void processAudioMessage(QSharedPointer<AudioMessage> audioMessage);
+    void processAudioMessage(QSharedPointer<AudioMessage> audioMessage, QHostAddress sender);
+    /** @brief A StopAudioStreamRequest for audioMessage->port, from the SSRC in audioMessage. */
+    void stopAudioMessage(QSharedPointer<AudioMessage> audioMessage, QHostAddress sender);
 private:
     MsgQueue& queue;
     MessageSerial& serial;
     AudioService& audioService;
+    QSet<SsrcId> remoteSsrcIds;
 };
 
 class NetworkReaderWriter : public QObject
@@ -79,7 +104,7 @@ private slots:
             socket.readDatagram(data.data(), data.size(), &sender, &senderPort);
 
             qDebug("NetworkReaderWriter::onReadyRead data:|%s| size:|%lli|", data.data(), data.size());
-            msgQueue.push(QSharedPointer<QByteArray>(new QByteArray(data)));
+            msgQueue.push(QSharedPointer<QByteArray>(new QByteArray(data)), sender);
         }
     }
 protected:
@@ -99,36 +124,113 @@ public:
     virtual ~NetworkManager();
     void startDiscovery();
     void stopDiscovery();
-    void connectToPeer(int index);
+    /** @brief How a connected peer receives our audio. */
+    enum class DeliveryMode {
+        Multicast,  // the multicast group, on every usable interface
+        Unicast,    // relayed to the peer's address, for networks that drop multicast
+    };
+    static constexpr quint16 defaultMediaPort = 3101;
+    static constexpr const char* defaultMediaGroup = "239.255.31.1";
+    static constexpr quint16 defaultControlPort = 3102;
+
+    void connectToPeer(int index, DeliveryMode mode = DeliveryMode::Multicast);
     void disconnectFromPeer(int index);
     void startAudioStreaming();
     void stopAudioStreaming();
-    QSharedPointer<AudioService> getAudioService(quint16 port) { return audioServices[port]; }
+    /** @brief Streams a WAV or raw PCM file instead of the capture device, from a shared mapping.
+     * @param rawFormat Format of path if it has no WAV header. */
+    bool startFileStreaming(const QString& path, const QAudioFormat& rawFormat = QAudioFormat(), bool loop = true);
+    void stopFileStreaming();
+    /** @brief Moves the control socket onto NetworkEngine threads, so a busy GUI no longer delays receiving.
+     * With several workers the port is sharded by flow, each peer's datagrams stay on one worker.
+     * If the engines can not start, the control socket is a QUdpSocket on this thread instead.
+     * The media sockets of AudioStreamer and DiscoveryEngine are on mediaEngine from construction.
+     * @return False if neither could bind controlPort. */
+    bool startNetworkEngine(quint16 controlPort, int workers = 1);
+    void stopNetworkEngine();
+    /** @brief Re-serves an upstream stream on another interface and announces ServiceType::Repeater.
+     * Peers connected in DeliveryMode::Unicast also get the repeated stream. */
+    bool startRepeater(const RepeaterConfig& config);
+    void stopRepeater();
+    /** @brief Sends a control request to the peer at index through the reliable control channel.
+     * @return The request ID, 0 if there is no such peer. */
+    quint32 sendControlRequest(int index, QSharedPointer<Message> request);
+    /** @brief Asks every peer in indices to start a stream on port, all requests outstanding at once. */
+    void requestAudioStreams(const QList<int>& indices, quint16 port = defaultMediaPort);
+    QSharedPointer<AudioService> getAudioService(quint16 port) const { return sessions.service(port); }
+    const StreamSessionManager& streamSessions() const { return sessions; }
 public slots:
     void sendData(QByteArray data, QHostAddress receiver, quint16 receiverPort);
-    void handleAudioMessage(QSharedPointer<AudioMessage> audioMessage)
+    void handleAudioMessage(QSharedPointer<AudioMessage> audioMessage, QHostAddress sender)
     {
-        if (audioServices.find(audioMessage->port) == audioServices.end()) {
-            audioServices[audioMessage->port] = audioServiceFactory.createAudioService(audioMessage->port);
-        }
-        else {
-            audioServices[audioMessage->port]->handleAudioMessage(audioMessage);
+        if (const StreamSession* session = sessions.find(audioMessage->port)) {
+            if (session->ssrcId != audioMessage->ssrcId) {
+                qWarning() << "NetworkManager - Port" << audioMessage->port << "is in use by SSRC" << session->ssrcId;
+                return;
+            }
+            session->service->handleAudioMessage(audioMessage);
+            return;
         }
+        sessions.open(audioMessage->ssrcId, audioMessage->port, peers.indexOf(sender),
+                      audioServiceFactory.createAudioService(audioMessage->port));
     }
 signals:
     void peerDiscovered(SsrcId ssrcId, ServiceType peerServices);
     void connectionStatusUpdated(int index, bool connected);
+    /** @brief The peer at index stopped answering and was removed, its index may be reused. */
+    void peerExpired(int index);
     void audioMessageReceived(QSharedPointer<AudioMessage> audioMessage);
+    /** @brief The peer at index acknowledged the StartAudioStreamRequest for port. */
+    void audioStreamAccepted(int index, quint16 port);
+    /** @brief The peer at index did not answer control request requestId, despite retransmissions. */
+    void controlRequestFailed(int index, quint32 requestId);
 private slots:
     void handlePeerDiscovery(QString name, QString address);
+    void handleDiscoveredPeer(SsrcId ssrcId, std::vector<ServiceType> svcAnnounces, QHostAddress address);
     void handleDataReceived(QByteArray data, QHostAddress sender, quint16 senderPort);
+    void handleControlRequest(QSharedPointer<Message> request, QHostAddress sender, quint16 senderPort);
+    void handleControlResponse(quint32 requestId, QSharedPointer<Message> response, QHostAddress sender);
+    void handleControlRequestFailed(quint32 requestId, QHostAddress peer);
+    void handleStopAudioMessage(QSharedPointer<AudioMessage> audioMessage, QHostAddress sender);
+    void handlePeerSsrc(SsrcId ssrcId, QHostAddress sender);
+    void handlePeerSeen(SsrcId ssrcId, QHostAddress address);
+    void handlePeerExpired(int index);
+    void readControlFallback();
 
 private:
-    QMap<quint16, QSharedPointer<AudioService> > audioServices;
+    /** @brief Subscribes or unsubscribes the peer at index on every fanout, including the repeater's. */
+    void setUnicastSubscriber(int index, const QHostAddress& address, bool subscribed);
+
+    // Indices are the ones reported to the UI through connectionStatusUpdated
+    PeerRegistry<QSharedPointer<NetworkPeer>> peers;
+    PeerLiveness* liveness;
+    // Owns the media sockets; declared before everything holding a streamer, so it is destroyed
+    // after them. Null if it could not start, the sockets are QUdpSockets then
+    std::unique_ptr<NetworkEngine> mediaEngine;
+    StreamSessionManager sessions;
+    // Shared by every streamer, declared before audioServiceFactory which is built with it
+    InterfaceMonitor* interfaceMonitor;
     AudioServiceFactory audioServiceFactory;
     MsgQueueProcessor& msgQueueProcessor;
     SsrcId ssrcId;
-    QTimer* discoveryTimer;
+    DiscoveryEngine* discoveryEngine;
+    // Receives and sends control traffic; replies leave from the socket of worker 0
+    std::unique_ptr<ReceiveShardGroup> controlShards;
+    // Unicast subscribers, keyed by peer index
+    QSharedPointer<UnicastFanout> fanout;
+    std::unique_ptr<FileAudioSource> fileSource;
+    // Control socket on the GUI thread, only open while controlShards is not
+    QUdpSocket* controlFallback = nullptr;
+    // Peers are expected to listen for control messages on the same port we do
+    quint16 controlPort = 0;
+    ControlChannel* control;
+    // Outstanding StartAudioStreamRequests: request ID to peer index
+    QHash<quint32, int> streamRequests;
+    // Runs on repeaterThread, so playout pacing does not depend on the GUI event loop
+    RepeaterService* repeater = nullptr;
+    // The repeater's copy of the unicast subscribers, only touched on repeaterThread
+    QSharedPointer<UnicastFanout> repeaterFanout;
+    QThread repeaterThread;
 };
 
 #endif // NETWORKMANAGER_H
@@ -0,0 +1,143 @@
+// PeerLiveness.h
+#ifndef PEERLIVENESS_H
+#define PEERLIVENESS_H
+#include <QObject>
+#include <QTimer>
+#include <algorithm>
+#include <vector>
+
+/**
+ * @brief Hashed timing wheel over small non-negative ids.
+ *
+ * slotCount slots of tickMs each; an id sits in the slot it expires in, linked through its
+ * node, so scheduling, rescheduling and removal are O(1). A deadline beyond one revolution
+ * keeps a round count that is decremented each time its slot comes around.
+ */
+class TimingWheel
+{
+public:
+    TimingWheel(int slotCount, int tickMs) : heads(slotCount, -1), tickMs(tickMs) {}
+
+    /** @brief (Re)schedules id to expire ttlMs from now, rounded up to whole ticks. */
+    void schedule(int id, int ttlMs) {
+        if (id >= static_cast<int>(nodes.size())) {
+            nodes.resize(id + 1);
+        }
+        unlink(id);
+        const int ticks = std::max(1, (ttlMs + tickMs - 1) / tickMs);
+        const int slotCount = static_cast<int>(heads.size());
+        Node& node = nodes[id];
+        node.slot = (cursor + ticks) % slotCount;
+        node.rounds = (ticks - 1) / slotCount;
+        node.prev = -1;
+        node.next = heads[node.slot];
+        if (node.next >= 0) {
+            nodes[node.next].prev = id;
+        }
+        heads[node.slot] = id;
+    }
+
+    void remove(int id) {
+        if (id >= 0 && id < static_cast<int>(nodes.size())) {
+            unlink(id);
+        }
+    }
+
+    bool contains(int id) const {
+        return id >= 0 && id < static_cast<int>(nodes.size()) && nodes[id].slot >= 0;
+    }
+
+    /** @brief Moves one tick ahead and appends the ids that expired to expired. */
+    void advance(std::vector<int>& expired) {
+        cursor = (cursor + 1) % static_cast<int>(heads.size());
+        for (int id = heads[cursor]; id >= 0;) {
+            Node& node = nodes[id];
+            const int next = node.next;
+            if (node.rounds > 0) {
+                --node.rounds;
+            } else {
+                unlink(id);
+                expired.push_back(id);
+            }
+            id = next;
+        }
+    }
+
+    int tickInterval() const { return tickMs; }
+
+private:
+    struct Node {
+        int prev = -1;
+        int next = -1;
+        int slot = -1;
+        int rounds = 0;
+    };
+
+    void unlink(int id) {
+        Node& node = nodes[id];
+        if (node.slot < 0) {
+            return;
+        }
+        if (node.prev >= 0) {
+            nodes[node.prev].next = node.next;
+        } else {
+            heads[node.slot] = node.next;
+        }
+        if (node.next >= 0) {
+            nodes[node.next].prev = node.prev;
+        }
+        node = Node();
+    }
+
+    std::vector<Node> nodes;
+    std::vector<int> heads;
+    int tickMs;
+    int cursor = 0;
+};
+
+/**
+ * @brief Expires peers that were not heard from within their TTL.
+ *
+ * Peers are identified by their PeerRegistry index. Every discovery message and every
+ * datagram from a peer calls touch(), which only relinks its wheel node; the wheel
+ * ticks once per second and only looks at the peers due in that second.
+ */
+class PeerLiveness : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PeerLiveness(int ttlMs, QObject* parent = nullptr)
+        : QObject(parent), ttlMs(ttlMs)
+    {
+        connect(&tickTimer, &QTimer::timeout, this, &PeerLiveness::tick);
+        tickTimer.start(wheel.tickInterval());
+    }
+    virtual ~PeerLiveness() = default;
+
+    /** @brief Marks the peer at index as alive for another TTL. */
+    void touch(int index) { wheel.schedule(index, ttlMs); }
+    /** @brief Stops tracking the peer at index, e.g. when it was removed for another reason. */
+    void forget(int index) { wheel.remove(index); }
+
+signals:
+    /** @brief The peer at index was silent for its whole TTL. */
+    void peerExpired(int index);
+
+private slots:
+    void tick() {
+        expired.clear();
+        wheel.advance(expired);
+        for (int index : expired) {
+            emit peerExpired(index);
+        }
+    }
+
+private:
+    // 256 one-second slots cover the TTL in one revolution
+    TimingWheel wheel{256, 1000};
+    QTimer tickTimer;
+    std::vector<int> expired;
+    int ttlMs;
+};
+
+#endif // PEERLIVENESS_H
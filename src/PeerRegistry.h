@@ -0,0 +1,173 @@
+// PeerRegistry.h
+#ifndef PEERREGISTRY_H
+#define PEERREGISTRY_H
+#include <QHostAddress>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <vector>
+#include "FlatHashMap.h"
+#include "Message.h"
+
+/**
+ * @brief Binary peer address, IPv4 stored IPv4-mapped so both families share one key type.
+ */
+struct PeerAddress
+{
+    std::array<quint8, 16> bytes{};
+
+    PeerAddress() = default;
+    explicit PeerAddress(const QHostAddress& address) {
+        const Q_IPV6ADDR ip6 = address.toIPv6Address();
+        std::memcpy(bytes.data(), ip6.c, bytes.size());
+    }
+    bool operator==(const PeerAddress& other) const { return bytes == other.bytes; }
+    bool operator!=(const PeerAddress& other) const { return bytes != other.bytes; }
+};
+
+struct PeerAddressHash
+{
+    size_t operator()(const PeerAddress& address) const {
+        quint64 lo, hi;
+        std::memcpy(&lo, address.bytes.data(), 8);
+        std::memcpy(&hi, address.bytes.data() + 8, 8);
+        // Fold and mix, the low bits pick the slot
+        quint64 h = (lo ^ (hi * 0x9E3779B97F4A7C15ull)) * 0xBF58476D1CE4E5B9ull;
+        return static_cast<size_t>(h ^ (h >> 31));
+    }
+};
+
+struct SsrcIdHash
+{
+    size_t operator()(SsrcId ssrcId) const {
+        quint64 h = static_cast<quint32>(ssrcId) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h ^ (h >> 29));
+    }
+};
+
+/**
+ * @brief Peers indexed by address and by SSRC.
+ *
+ * Every peer gets a stable index on insertion, which the UI uses to refer to it; the index
+ * stays valid until the peer is removed and is only reused by a later insertion. Lookups
+ * by address (per datagram) and by SSRC (per message) are O(1).
+ */
+template <typename Peer>
+class PeerRegistry
+{
+public:
+    /** @return Index of the peer at address, or -1. */
+    int indexOf(const QHostAddress& address) const { return byAddress.find(PeerAddress(address)); }
+    /** @return Index of the peer announcing ssrcId, or -1. */
+    int indexOfSsrc(SsrcId ssrcId) const { return bySsrc.find(ssrcId); }
+
+    /** @return The peer at address, or a default constructed Peer. */
+    Peer findByAddress(const QHostAddress& address) const { return at(indexOf(address)); }
+    /** @return The peer announcing ssrcId, or a default constructed Peer. */
+    Peer findBySsrc(SsrcId ssrcId) const { return at(indexOfSsrc(ssrcId)); }
+
+    /** @return The peer at index, or a default constructed Peer if there is none. */
+    Peer at(int index) const {
+        return contains(index) ? entries[index].peer : Peer();
+    }
+    bool contains(int index) const {
+        return index >= 0 && index < static_cast<int>(entries.size()) && entries[index].used;
+    }
+
+    /** @return SSRC associated with the peer at index, if any. */
+    std::optional<SsrcId> ssrcOf(int index) const {
+        if (!contains(index) || !entries[index].hasSsrc) {
+            return std::nullopt;
+        }
+        return entries[index].ssrcId;
+    }
+
+    /** @brief Adds a peer reachable at address, or replaces the one already there.
+     * @return Index of the peer. */
+    int insert(const QHostAddress& address, Peer peer) {
+        const PeerAddress key(address);
+        int index = byAddress.find(key);
+        if (index < 0) {
+            if (!freeIndices.empty()) {
+                index = freeIndices.back();
+                freeIndices.pop_back();
+            } else {
+                index = static_cast<int>(entries.size());
+                entries.emplace_back();
+            }
+            byAddress.insert(key, index);
+            ++liveCount;
+        }
+        Entry& entry = entries[index];
+        entry.peer = std::move(peer);
+        entry.address = key;
+        entry.used = true;
+        return index;
+    }
+
+    /** @brief Associates ssrcId with the peer at index, replacing an earlier SSRC of that peer.
+     * A peer that held ssrcId before, e.g. an old address of a host that moved, loses it. */
+    void setSsrc(int index, SsrcId ssrcId) {
+        if (!contains(index)) {
+            return;
+        }
+        if (int owner = bySsrc.find(ssrcId); owner >= 0 && owner != index) {
+            entries[owner].hasSsrc = false;
+            bySsrc.erase(ssrcId);
+        }
+        Entry& entry = entries[index];
+        if (entry.hasSsrc) {
+            bySsrc.erase(entry.ssrcId);
+        }
+        entry.ssrcId = ssrcId;
+        entry.hasSsrc = true;
+        bySsrc.insert(ssrcId, index);
+    }
+
+    void remove(int index) {
+        if (!contains(index)) {
+            return;
+        }
+        Entry& entry = entries[index];
+        byAddress.erase(entry.address);
+        if (entry.hasSsrc) {
+            bySsrc.erase(entry.ssrcId);
+        }
+        entry = Entry();
+        freeIndices.push_back(index);
+        --liveCount;
+    }
+
+    /** @brief Number of peers. */
+    int size() const { return liveCount; }
+    /** @brief One past the highest index ever handed out. */
+    int indexEnd() const { return static_cast<int>(entries.size()); }
+
+    /** @brief Calls fn(index, peer) for every peer in index order. */
+    template <typename F>
+    void forEach(F&& fn) const {
+        for (int i = 0; i < static_cast<int>(entries.size()); ++i) {
+            if (entries[i].used) {
+                fn(i, entries[i].peer);
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        Peer peer{};
+        PeerAddress address;
+        SsrcId ssrcId = 0;
+        bool hasSsrc = false;
+        bool used = false;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<int> freeIndices;
+    FlatHashMap<PeerAddress, PeerAddressHash> byAddress;
+    FlatHashMap<SsrcId, SsrcIdHash> bySsrc;
+    int liveCount = 0;
+};
+
+#endif // PEERREGISTRY_H
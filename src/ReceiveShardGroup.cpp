@@ -0,0 +1,89 @@
+// ReceiveShardGroup.cpp
+#include <QDebug>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/filter.h>
+#include <sys/socket.h>
+#include "ReceiveShardGroup.h"
+
+ReceiveShardGroup::ReceiveShardGroup(int workers, NetworkEngine::Backend backend)
+{
+    workers = std::max(1, workers);
+    for (int i = 0; i < workers; i++) {
+        engines.push_back(std::make_unique<NetworkEngine>(backend));
+    }
+}
+
+ReceiveShardGroup::~ReceiveShardGroup()
+{
+    close();
+}
+
+bool ReceiveShardGroup::open(const QHostAddress& address, quint16 port, ShardHandler handler, Steering steering)
+{
+    close();
+    // Sockets join the reuseport group in bind order, which is the index the BPF program returns
+    for (int shard = 0; shard < workerCount(); shard++) {
+        // Running first, so a socket closed on failure below is closed right away
+        if (!engines[shard]->start()) {
+            close();
+            return false;
+        }
+        const int fd = engines[shard]->openUdp(address, port,
+            [handler, shard](const char* data, size_t size, const QHostAddress& sender, quint16 senderPort) {
+                handler(shard, data, size, sender, senderPort);
+            }, true);
+        if (fd < 0) {
+            close();
+            return false;
+        }
+        sockets.push_back(fd);
+    }
+    if (steering == Steering::Ssrc && !attachSsrcSteering(sockets.front())) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ReceiveShardGroup::close()
+{
+    for (size_t shard = 0; shard < sockets.size(); shard++) {
+        engines[shard]->closeSocket(sockets[shard]);
+    }
+    for (auto& engine : engines) {
+        engine->stop();
+    }
+    sockets.clear();
+}
+
+bool ReceiveShardGroup::attachSsrcSteering(int fd) const
+{
+    const quint32 workers = static_cast<quint32>(workerCount());
+    // Runs on the UDP payload. RTP/RTCP version 2 packets are steered by their SSRC: at offset 4
+    // for RTCP (packet types 200-204), at offset 8 for RTP. Anything else gets an index past the
+    // last socket, which makes the kernel fall back to its flow hash.
+    sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 12, 0, 11),     // shorter than an RTP header
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0),
+        BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xC0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x80, 0, 8),    // not version 2
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 1),
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 200, 0, 3),     // RTP
+        BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, 204, 2, 0),     // RTP, marker bit set
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 4),              // RTCP sender SSRC
+        BPF_JUMP(BPF_JMP | BPF_JA, 1, 0, 0),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 8),              // RTP SSRC
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, workers),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+        BPF_STMT(BPF_RET | BPF_K, 0xffffffff),              // not RTP, flow hash
+    };
+    sock_fprog program = { static_cast<unsigned short>(sizeof(code) / sizeof(code[0])), code };
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) < 0) {
+        qWarning() << "ReceiveShardGroup - Failed to attach SSRC steering:" << strerror(errno);
+        return false;
+    }
+    return true;
+}
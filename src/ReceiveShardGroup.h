@@ -0,0 +1,53 @@
+// ReceiveShardGroup.h
+#ifndef RECEIVESHARDGROUP_H
+#define RECEIVESHARDGROUP_H
+#include <QHostAddress>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "NetworkEngine.h"
+
+/**
+ * @brief Spreads the receive load of one UDP port over several worker threads.
+ *
+ * Every worker is a NetworkEngine with its own socket bound to the same port with SO_REUSEPORT,
+ * so the kernel picks the worker per datagram and no thread hands packets to another. All
+ * datagrams of one flow land on the same worker, which keeps their order:
+ * - FlowHash: the kernel hashes the address/port 4-tuple.
+ * - Ssrc: a classic BPF program reads the SSRC of RTP and RTCP packets and picks worker
+ *   SSRC % workers, so a peer's media and reports stay together even when they come from
+ *   different source ports; other datagrams fall back to the flow hash.
+ */
+class ReceiveShardGroup
+{
+public:
+    enum class Steering { FlowHash, Ssrc };
+
+    /** @brief Called on the thread of worker shard; data is only valid during the call. */
+    using ShardHandler = std::function<void(int shard, const char* data, size_t size, const QHostAddress& sender, quint16 senderPort)>;
+
+    explicit ReceiveShardGroup(int workers, NetworkEngine::Backend backend = NetworkEngine::Backend::Epoll);
+    ~ReceiveShardGroup();
+    ReceiveShardGroup(const ReceiveShardGroup&) = delete;
+    ReceiveShardGroup& operator=(const ReceiveShardGroup&) = delete;
+
+    /** @brief Binds one socket per worker to address:port and starts the workers.
+     * @return False if any socket failed; with Ssrc steering, also if the BPF program was refused. */
+    bool open(const QHostAddress& address, quint16 port, ShardHandler handler, Steering steering = Steering::FlowHash);
+    /** @brief Stops the workers and closes their sockets. */
+    void close();
+
+    int workerCount() const { return static_cast<int>(engines.size()); }
+    /** @brief Socket of worker shard, e.g. for replies that should leave from the same port. */
+    int socketOf(int shard) const { return sockets[shard]; }
+    NetworkEngine& engineOf(int shard) { return *engines[shard]; }
+
+private:
+    /** @brief Attaches the SSRC steering program to the reuseport group of fd. */
+    bool attachSsrcSteering(int fd) const;
+
+    std::vector<std::unique_ptr<NetworkEngine>> engines;
+    std::vector<int> sockets;
+};
+
+#endif // RECEIVESHARDGROUP_H
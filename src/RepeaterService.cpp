@@ -0,0 +1,122 @@
+// RepeaterService.cpp
+#include <QDebug>
+#include "RepeaterService.h"
+
+RepeaterService::RepeaterService(const RepeaterConfig& config, QObject* parent)
+    : QObject(parent)
+    , config(config)
+    , upstream(new QUdpSocket(this))
+    , downstream(new QUdpSocket(this))
+    , playoutTimer(new QTimer(this))
+    , clockSync(config.clockRate)
+{
+    playoutTimer->setSingleShot(true);
+    playoutTimer->setTimerType(Qt::PreciseTimer);
+    connect(playoutTimer, &QTimer::timeout, this, &RepeaterService::playDue);
+    connect(upstream, &QUdpSocket::readyRead, this, &RepeaterService::readUpstream);
+}
+
+bool RepeaterService::start()
+{
+    if (upstream->state() == QAbstractSocket::BoundState) {
+        return true;
+    }
+    if (!upstream->bind(QHostAddress::AnyIPv4, config.upstreamPort, QUdpSocket::ReuseAddressHint | QUdpSocket::ShareAddress)) {
+        qWarning() << "RepeaterService - Failed to bind port" << config.upstreamPort << ":" << upstream->errorString();
+        return false;
+    }
+    const bool joined = config.upstreamInterface.isValid()
+        ? upstream->joinMulticastGroup(config.upstreamGroup, config.upstreamInterface)
+        : upstream->joinMulticastGroup(config.upstreamGroup);
+    if (!joined) {
+        qWarning() << "RepeaterService - Failed to join" << config.upstreamGroup << ":" << upstream->errorString();
+        upstream->close();
+        return false;
+    }
+    if (!downstream->bind(QHostAddress::AnyIPv4, 0)) {
+        qWarning() << "RepeaterService - Failed to bind downstream socket:" << downstream->errorString();
+        upstream->close();
+        return false;
+    }
+    if (config.downstreamInterface.isValid()) {
+        downstream->setMulticastInterface(config.downstreamInterface);
+    }
+    // Each segment is served by its own repeater, do not leak past the local router
+    downstream->setSocketOption(QAbstractSocket::MulticastTtlOption, 1);
+    // Our own re-served packets must not come back in when both sides share a group
+    downstream->setSocketOption(QAbstractSocket::MulticastLoopbackOption, 0);
+    clock.start();
+    qDebug() << "RepeaterService - Repeating" << config.upstreamGroup << config.upstreamPort
+             << "to" << config.downstreamGroup << config.downstreamPort;
+    return true;
+}
+
+void RepeaterService::stop()
+{
+    playoutTimer->stop();
+    upstream->close();
+    downstream->close();
+    jitter.clear();
+    clockSync.reset();
+    hasStream = false;
+}
+
+void RepeaterService::readUpstream()
+{
+    while (upstream->hasPendingDatagrams()) {
+        QByteArray datagram;
+        datagram.resize(int(upstream->pendingDatagramSize()));
+        if (upstream->readDatagram(datagram.data(), datagram.size()) < 0) {
+            continue;
+        }
+        RtpPacket rtp;
+        if (!rtp.parse(datagram.constData(), size_t(datagram.size()))) {
+            forward(datagram);
+            continue;
+        }
+        if (!hasStream || rtp.ssrc != streamSsrc) {
+            // Whatever is still buffered belongs to a stream nobody sends anymore
+            jitter.clear();
+            clockSync.reset();
+            streamSsrc = rtp.ssrc;
+            hasStream = true;
+        }
+        const qint64 arrivalUs = nowUs();
+        const qint64 playoutUs = clockSync.playoutUs(rtp.timestamp, arrivalUs, qint64(config.targetDelayMs) * 1000);
+        jitter.insert(rtp.sequence, playoutUs, datagram);
+    }
+    playDue();
+}
+
+void RepeaterService::playDue()
+{
+    QByteArray packet;
+    const qint64 now = nowUs();
+    while (jitter.popDue(now, packet)) {
+        forward(packet);
+    }
+    schedulePlayout();
+}
+
+void RepeaterService::schedulePlayout()
+{
+    const qint64 nextUs = jitter.nextPlayoutUs();
+    if (nextUs < 0) {
+        playoutTimer->stop();
+        return;
+    }
+    const qint64 delayMs = std::max<qint64>(0, (nextUs - nowUs() + 999) / 1000);
+    playoutTimer->start(int(delayMs));
+}
+
+void RepeaterService::forward(const QByteArray& packet)
+{
+    if (downstream->writeDatagram(packet, config.downstreamGroup, config.downstreamPort) < 0) {
+        qWarning() << "RepeaterService - Failed to send:" << downstream->errorString();
+        return;
+    }
+    if (fanout) {
+        fanout->send(packet.constData(), size_t(packet.size()));
+    }
+    forwarded++;
+}
@@ -0,0 +1,79 @@
+// RepeaterService.h
+#ifndef REPEATERSERVICE_H
+#define REPEATERSERVICE_H
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QNetworkInterface>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QUdpSocket>
+#include "JitterBuffer.h"
+#include "UnicastFanout.h"
+
+/** @brief Where a repeater listens and where it re-serves. */
+struct RepeaterConfig
+{
+    QHostAddress upstreamGroup;
+    quint16 upstreamPort = 0;
+    QNetworkInterface upstreamInterface;
+    QHostAddress downstreamGroup;
+    quint16 downstreamPort = 0;
+    QNetworkInterface downstreamInterface;
+    int clockRate = 48000;
+    // Jitter absorbed before playout; adds to the end-to-end latency of every hop
+    int targetDelayMs = 60;
+};
+
+/**
+ * @brief Joins one upstream multicast stream and re-serves it on another interface (ServiceType::Repeater).
+ *
+ * The upstream server sends one stream per repeater instead of one per listener, and repeaters
+ * can feed other repeaters, so its uplink stays flat however many rooms are behind them.
+ * RTP packets are reordered by a JitterBuffer and re-sent paced by the sender's RTP clock, as
+ * mapped onto ours by RtpClockSync, so downstream sees a stream as smooth as the source rather
+ * than the upstream network's jitter. RTCP and anything that is not RTP is forwarded as is,
+ * unpaced; that includes the QDataStream-framed PCM AudioStreamer sends today.
+ * Meant to live on its own thread: every socket and timer is a child and moves with it.
+ */
+class RepeaterService : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RepeaterService(const RepeaterConfig& config, QObject* parent = nullptr);
+    virtual ~RepeaterService() = default;
+    /** @brief Also relays every packet to the unicast subscribers of fanout. */
+    void setFanout(QSharedPointer<UnicastFanout> fanout) { this->fanout = fanout; }
+
+    quint64 forwardedPackets() const { return forwarded; }
+    quint64 latePackets() const { return jitter.late(); }
+    quint64 lostPackets() const { return jitter.lost(); }
+
+public slots:
+    bool start();
+    void stop();
+
+private slots:
+    void readUpstream();
+    void playDue();
+
+private:
+    void forward(const QByteArray& packet);
+    void schedulePlayout();
+    qint64 nowUs() const { return clock.nsecsElapsed() / 1000; }
+
+    RepeaterConfig config;
+    QUdpSocket* upstream;
+    QUdpSocket* downstream;
+    QTimer* playoutTimer;
+    QSharedPointer<UnicastFanout> fanout;
+    QElapsedTimer clock;
+    JitterBuffer jitter;
+    RtpClockSync clockSync;
+    // The stream being repeated; a new SSRC restarts the buffer and the clock mapping
+    quint32 streamSsrc = 0;
+    bool hasStream = false;
+    quint64 forwarded = 0;
+};
+
+#endif // REPEATERSERVICE_H
@@ -0,0 +1,56 @@
+// RtpPacket.h
+#ifndef RTPPACKET_H
+#define RTPPACKET_H
+#include <QtEndian>
+#include <QtGlobal>
+#include <cstddef>
+
+/**
+ * @brief Read-only view of the fixed RTP header (RFC 3550) at the start of a datagram.
+ */
+struct RtpPacket
+{
+    quint8 payloadType = 0;
+    bool marker = false;
+    quint16 sequence = 0;
+    quint32 timestamp = 0;
+    quint32 ssrc = 0;
+    // Fixed header, CSRC list and header extension
+    size_t headerSize = 0;
+
+    /** @return True if data starts with a valid RTP version 2 header that is not RTCP. */
+    bool parse(const char* data, size_t size) {
+        const auto* bytes = reinterpret_cast<const uchar*>(data);
+        if (size < 12 || (bytes[0] >> 6) != 2 || isRtcp(data, size)) {
+            return false;
+        }
+        const size_t csrcCount = bytes[0] & 0x0F;
+        headerSize = 12 + csrcCount * 4;
+        if (bytes[0] & 0x10) {
+            if (size < headerSize + 4) {
+                return false;
+            }
+            headerSize += 4 + size_t(qFromBigEndian<quint16>(bytes + headerSize + 2)) * 4;
+        }
+        if (size < headerSize) {
+            return false;
+        }
+        marker = bytes[1] & 0x80;
+        payloadType = bytes[1] & 0x7F;
+        sequence = qFromBigEndian<quint16>(bytes + 2);
+        timestamp = qFromBigEndian<quint32>(bytes + 4);
+        ssrc = qFromBigEndian<quint32>(bytes + 8);
+        return true;
+    }
+
+    /** @brief RTCP shares the port with RTP (RFC 5761), packet types 200-204 tell them apart. */
+    static bool isRtcp(const char* data, size_t size) {
+        const auto* bytes = reinterpret_cast<const uchar*>(data);
+        return size >= 8 && (bytes[0] >> 6) == 2 && bytes[1] >= 200 && bytes[1] <= 204;
+    }
+
+    /** @brief Signed distance from b to a in sequence space, correct across wraparound. */
+    static qint16 sequenceDiff(quint16 a, quint16 b) { return static_cast<qint16>(a - b); }
+};
+
+#endif // RTPPACKET_H
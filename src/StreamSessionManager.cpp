@@ -0,0 +1,67 @@
+// StreamSessionManager.cpp
+#include "StreamSessionManager.h"
+
+const StreamSession* StreamSessionManager::find(quint16 port) const
+{
+    const int position = byPort.find(port);
+    return position < 0 ? nullptr : &sessions[position];
+}
+
+QSharedPointer<AudioService> StreamSessionManager::service(quint16 port) const
+{
+    const StreamSession* session = find(port);
+    return session ? session->service : QSharedPointer<AudioService>();
+}
+
+bool StreamSessionManager::open(SsrcId ssrcId, quint16 port, int peerIndex, QSharedPointer<AudioService> service)
+{
+    if (byPort.find(port) >= 0) {
+        return false;
+    }
+    byPort.insert(port, static_cast<int>(sessions.size()));
+    sessions.push_back({ ssrcId, port, peerIndex, service });
+    if (peerIndex >= 0) {
+        peerPorts[peerIndex].append(port);
+    }
+    emit sessionOpened(ssrcId, port);
+    return true;
+}
+
+void StreamSessionManager::close(quint16 port)
+{
+    const int position = byPort.find(port);
+    if (position < 0) {
+        return;
+    }
+    const int peerIndex = sessions[position].peerIndex;
+    if (auto it = peerPorts.find(peerIndex); it != peerPorts.end()) {
+        it->removeOne(port);
+        if (it->isEmpty()) {
+            peerPorts.erase(it);
+        }
+    }
+    removeAt(position);
+}
+
+void StreamSessionManager::closePeer(int peerIndex)
+{
+    for (quint16 port : peerPorts.take(peerIndex)) {
+        if (const int position = byPort.find(port); position >= 0) {
+            removeAt(position);
+        }
+    }
+}
+
+void StreamSessionManager::removeAt(int position)
+{
+    StreamSession session = std::move(sessions[position]);
+    byPort.erase(session.port);
+    // Fill the hole with the last session to keep the vector dense
+    const int last = static_cast<int>(sessions.size()) - 1;
+    if (position != last) {
+        sessions[position] = std::move(sessions[last]);
+        byPort.insert(sessions[position].port, position);
+    }
+    sessions.pop_back();
+    emit sessionClosed(session.ssrcId, session.port);
+}
@@ -0,0 +1,71 @@
+// StreamSessionManager.h
+#ifndef STREAMSESSIONMANAGER_H
+#define STREAMSESSIONMANAGER_H
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QSharedPointer>
+#include <vector>
+#include "AudioService.h"
+#include "FlatHashMap.h"
+#include "Message.h"
+
+/**
+ * @brief One audio stream, owned by the SSRC that started it on its port.
+ */
+struct StreamSession
+{
+    SsrcId ssrcId = 0;
+    quint16 port = 0;
+    // PeerRegistry index of the peer that started it, -1 if unknown
+    int peerIndex = -1;
+    QSharedPointer<AudioService> service;
+};
+
+struct PortHash
+{
+    size_t operator()(quint16 port) const { return static_cast<size_t>(port) * 0x9E3779B1u >> 7; }
+};
+
+/**
+ * @brief Audio stream sessions, at most one per port and therefore one per (SSRC, port).
+ *
+ * Sessions are kept densely in a vector, so listing them walks contiguous memory; a flat
+ * hash map from port to position routes control messages in constant time. Lookups never
+ * create entries.
+ */
+class StreamSessionManager : public QObject
+{
+    Q_OBJECT
+public:
+    explicit StreamSessionManager(QObject* parent = nullptr) : QObject(parent) {}
+    virtual ~StreamSessionManager() = default;
+
+    /** @return The session on port, or nullptr. */
+    const StreamSession* find(quint16 port) const;
+    /** @return The service of the session on port, or a null pointer. */
+    QSharedPointer<AudioService> service(quint16 port) const;
+
+    /** @brief Opens a session for ssrcId on port.
+     * @return False if port is taken, by the same or another SSRC. */
+    bool open(SsrcId ssrcId, quint16 port, int peerIndex, QSharedPointer<AudioService> service);
+    void close(quint16 port);
+    /** @brief Closes every session started by the peer at peerIndex. */
+    void closePeer(int peerIndex);
+
+    const std::vector<StreamSession>& activeSessions() const { return sessions; }
+    int size() const { return static_cast<int>(sessions.size()); }
+
+signals:
+    void sessionOpened(SsrcId ssrcId, quint16 port);
+    void sessionClosed(SsrcId ssrcId, quint16 port);
+
+private:
+    void removeAt(int position);
+
+    std::vector<StreamSession> sessions;
+    FlatHashMap<quint16, PortHash> byPort;
+    QHash<int, QList<quint16>> peerPorts;
+};
+
+#endif // STREAMSESSIONMANAGER_H
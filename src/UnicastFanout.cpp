@@ -0,0 +1,119 @@
+// UnicastFanout.cpp
+#include <QDebug>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "UnicastFanout.h"
+
+UnicastFanout::UnicastFanout()
+{
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        qWarning() << "UnicastFanout - Failed to create socket:" << strerror(errno);
+        return;
+    }
+    // Room for one packet to every subscriber of a large relay
+    const int sendBuffer = 1 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+}
+
+UnicastFanout::~UnicastFanout()
+{
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool UnicastFanout::addSubscriber(int id, const QHostAddress& address, quint16 port)
+{
+    bool isIPv4 = false;
+    const quint32 ipv4 = address.toIPv4Address(&isIPv4);
+    if (!isIPv4) {
+        qWarning() << "UnicastFanout - Not an IPv4 address:" << address;
+        return false;
+    }
+    sockaddr_in destination{};
+    destination.sin_family = AF_INET;
+    destination.sin_port = htons(port);
+    destination.sin_addr.s_addr = htonl(ipv4);
+    if (const int position = byId.find(id); position >= 0) {
+        addresses[position] = destination;
+    } else {
+        byId.insert(id, static_cast<int>(ids.size()));
+        ids.push_back(id);
+        addresses.push_back(destination);
+    }
+    messagesDirty = true;
+    return true;
+}
+
+void UnicastFanout::removeSubscriber(int id)
+{
+    const int position = byId.find(id);
+    if (position < 0) {
+        return;
+    }
+    byId.erase(id);
+    // Move the last subscriber into the hole
+    const int last = static_cast<int>(ids.size()) - 1;
+    if (position != last) {
+        ids[position] = ids[last];
+        addresses[position] = addresses[last];
+        byId.insert(ids[position], position);
+    }
+    ids.pop_back();
+    addresses.pop_back();
+    messagesDirty = true;
+}
+
+void UnicastFanout::rebuildMessages()
+{
+    messages.assign(addresses.size(), mmsghdr{});
+    for (size_t i = 0; i < addresses.size(); i++) {
+        msghdr& header = messages[i].msg_hdr;
+        header.msg_name = &addresses[i];
+        header.msg_namelen = sizeof(sockaddr_in);
+        header.msg_iov = &packet;
+        header.msg_iovlen = 1;
+    }
+    messagesDirty = false;
+}
+
+int UnicastFanout::send(const char* data, size_t size)
+{
+    if (fd < 0 || ids.empty()) {
+        return 0;
+    }
+    if (messagesDirty) {
+        rebuildMessages();
+    }
+    packet.iov_base = const_cast<char*>(data);
+    packet.iov_len = size;
+
+    const int total = static_cast<int>(messages.size());
+    int offset = 0;
+    int failed = 0;
+    while (offset < total) {
+        const unsigned int batch = static_cast<unsigned int>(std::min(total - offset, UIO_MAXIOV));
+        const int sent = sendmmsg(fd, messages.data() + offset, batch, MSG_DONTWAIT);
+        if (sent > 0) {
+            offset += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) {
+            // Socket buffer full, the rest of this packet is lost for everyone left
+            drops.fetch_add(total - offset, std::memory_order_relaxed);
+            return offset - failed;
+        }
+        // This subscriber failed (e.g. unreachable), carry on with the next one
+        drops.fetch_add(1, std::memory_order_relaxed);
+        failed++;
+        offset++;
+    }
+    return total - failed;
+}
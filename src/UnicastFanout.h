@@ -0,0 +1,56 @@
+// UnicastFanout.h
+#ifndef UNICASTFANOUT_H
+#define UNICASTFANOUT_H
+#include <QHostAddress>
+#include <atomic>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "FlatHashMap.h"
+
+/**
+ * @brief Relays each packet to a list of unicast subscribers, for networks that drop multicast.
+ *
+ * The packet is encoded once; every subscriber's message points at the same buffer and the
+ * whole list goes out with sendmmsg, up to UIO_MAXIOV datagrams per syscall. The message
+ * array is only rebuilt when subscribers change. Subscribers are keyed by the PeerRegistry
+ * index of their peer. IPv4 only, like the multicast path.
+ */
+class UnicastFanout
+{
+public:
+    UnicastFanout();
+    ~UnicastFanout();
+    UnicastFanout(const UnicastFanout&) = delete;
+    UnicastFanout& operator=(const UnicastFanout&) = delete;
+
+    /** @brief Adds or moves subscriber id. @return False for addresses that are not IPv4. */
+    bool addSubscriber(int id, const QHostAddress& address, quint16 port);
+    void removeSubscriber(int id);
+    bool hasSubscriber(int id) const { return byId.find(id) >= 0; }
+    int subscriberCount() const { return static_cast<int>(ids.size()); }
+
+    /** @brief Sends data to every subscriber. @return Number of subscribers it was sent to. */
+    int send(const char* data, size_t size);
+    /** @brief Datagrams not sent because the socket buffer was full or the send failed. */
+    quint64 droppedSends() const { return drops.load(std::memory_order_relaxed); }
+
+private:
+    struct IdHash {
+        size_t operator()(int id) const { return static_cast<size_t>(static_cast<quint32>(id) * 0x9E3779B1u); }
+    };
+
+    void rebuildMessages();
+
+    int fd = -1;
+    std::vector<int> ids;
+    std::vector<sockaddr_in> addresses;
+    FlatHashMap<int, IdHash> byId;
+    // Shared by every message, points at the packet being sent
+    iovec packet{};
+    std::vector<mmsghdr> messages;
+    bool messagesDirty = false;
+    std::atomic<quint64> drops{0};
+};
+
+#endif // UNICASTFANOUT_H
@@ -0,0 +1,64 @@
+// Bench.h
+#ifndef BENCH_H
+#define BENCH_H
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Durations of one measured operation, reported as median, 99th percentile and rate.
+ */
+class BenchStats
+{
+public:
+    void add(int64_t ns) { samples.push_back(ns); }
+    bool empty() const { return samples.empty(); }
+
+    void report(const std::string& name) {
+        if (samples.empty()) {
+            std::printf("%-32s no samples\n", name.c_str());
+            return;
+        }
+        std::sort(samples.begin(), samples.end());
+        int64_t total = 0;
+        for (int64_t ns : samples) {
+            total += ns;
+        }
+        const double median = samples[samples.size() / 2] / 1000.0;
+        const double p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)] / 1000.0;
+        std::printf("%-32s %8zu runs  median %10.1f us  p99 %10.1f us  %10.0f ops/s\n",
+                    name.c_str(), samples.size(), median, p99, samples.size() * 1e9 / double(total));
+    }
+
+private:
+    std::vector<int64_t> samples;
+};
+
+inline int64_t benchNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** @return The value of --name=value in argv, or fallback. */
+inline long benchOption(int argc, char* argv[], const std::string& name, long fallback)
+{
+    const std::string prefix = "--" + name + "=";
+    for (int i = 0; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0) {
+            return std::stol(arg.substr(prefix.size()));
+        }
+    }
+    return fallback;
+}
+
+// One entry point per benchmark, argv holds the options after the benchmark name
+int runNftSetBench(int argc, char* argv[]);
+int runControlSocketBench(int argc, char* argv[]);
+int runPacketRateBench(int argc, char* argv[]);
+
+#endif // BENCH_H
@@ -0,0 +1,38 @@
+// BenchMain.cpp
+#include <cstring>
+#include "Bench.h"
+
+namespace {
+struct Benchmark {
+    const char* name;
+    int (*run)(int argc, char* argv[]);
+    const char* description;
+};
+
+const Benchmark benchmarks[] = {
+#ifdef BLUELINE_BENCH_NFT
+    { "nft-set", runNftSetBench,
+      "nftables set element updates, libnftables JSON vs netlink batch (--elements=16 --updates=200, needs CAP_NET_ADMIN)" },
+#endif
+    { "control-socket", runControlSocketBench,
+      "round trip of update requests to a running ipmon (--requests=1000 --pipeline=1)" },
+    { "packet-rate", runPacketRateBench,
+      "UDP receive rate per core, io_uring vs epoll NetworkEngine vs QUdpSocket (--size=200 --seconds=3)" },
+};
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc >= 2) {
+        for (const Benchmark& benchmark : benchmarks) {
+            if (std::strcmp(argv[1], benchmark.name) == 0) {
+                return benchmark.run(argc - 2, argv + 2);
+            }
+        }
+    }
+    std::printf("Usage: %s <benchmark> [--option=value ...]\n", argv[0]);
+    for (const Benchmark& benchmark : benchmarks) {
+        std::printf("  %-16s %s\n", benchmark.name, benchmark.description);
+    }
+    return 1;
+}
@@ -0,0 +1,88 @@
+// ControlSocketBench.cpp
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Bench.h"
+
+namespace {
+constexpr const char* defaultSocketPath = "/run/ipmon.sock";
+constexpr int replyTimeoutMs = 1000;
+
+/** @return True once count empty replies arrived, false on timeout or error. */
+bool awaitReplies(int fd, long count)
+{
+    char buf[16];
+    while (count > 0) {
+        pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, replyTimeoutMs) <= 0) {
+            return false;
+        }
+        while (count > 0 && recv(fd, buf, sizeof(buf), MSG_DONTWAIT) >= 0) {
+            count--;
+        }
+        if (count > 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+// Round trip of "update" requests to a running ipmon: sent, the update runs in its event loop,
+// the empty reply comes back. --pipeline requests go out before the replies are awaited, they
+// share one wakeup of ipmon.
+int runControlSocketBench(int argc, char* argv[])
+{
+    const long requests = benchOption(argc, argv, "requests", 1000);
+    const long pipeline = std::max(1L, benchOption(argc, argv, "pipeline", 1));
+
+    const int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::fprintf(stderr, "control-socket: socket: %s\n", std::strerror(errno));
+        return 1;
+    }
+    // ipmon only replies to bound senders; an abstract address needs no cleanup
+    sockaddr_un local{};
+    local.sun_family = AF_UNIX;
+    const int nameLength = std::snprintf(local.sun_path + 1, sizeof(local.sun_path) - 1, "blueline-bench-%d", getpid());
+    const socklen_t localLength = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + nameLength);
+    sockaddr_un server{};
+    server.sun_family = AF_UNIX;
+    std::strncpy(server.sun_path, defaultSocketPath, sizeof(server.sun_path) - 1);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&local), localLength) < 0
+        || connect(fd, reinterpret_cast<sockaddr*>(&server), sizeof(server)) < 0) {
+        std::fprintf(stderr, "control-socket: can not reach ipmon at %s: %s\n", defaultSocketPath, std::strerror(errno));
+        close(fd);
+        return 1;
+    }
+
+    static constexpr char command[] = "update";
+    BenchStats roundTrips;
+    int failures = 0;
+    for (long sent = 0; sent < requests; sent += pipeline) {
+        const long batch = std::min(pipeline, requests - sent);
+        const int64_t start = benchNowNs();
+        for (long i = 0; i < batch; i++) {
+            if (send(fd, command, sizeof(command) - 1, 0) < 0) {
+                failures++;
+            }
+        }
+        if (!awaitReplies(fd, batch)) {
+            failures++;
+            continue;
+        }
+        roundTrips.add(benchNowNs() - start);
+    }
+    close(fd);
+
+    std::printf("%ld requests, %ld per round trip\n", requests, pipeline);
+    roundTrips.report("ipmon update round trip");
+    if (failures) {
+        std::fprintf(stderr, "control-socket: %d requests failed or timed out\n", failures);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+// NftSetBench.cpp
+#include <arpa/inet.h>
+#include <memory>
+#include <nftables/libnftables.h>
+#include "Bench.h"
+#include "NftGenerator.h"
+#include "NftNetlinkWriter.h"
+
+// Updates the elements of one throwaway set, the way ipmon applies an address change:
+// each update adds a batch of addresses, the next one deletes them again.
+int runNftSetBench(int argc, char* argv[])
+{
+    const long elements = benchOption(argc, argv, "elements", 16);
+    const long updates = benchOption(argc, argv, "updates", 200);
+
+    std::unique_ptr<struct nft_ctx, void (*)(struct nft_ctx*)> nft{ nft_ctx_new(NFT_CTX_DEFAULT), nft_ctx_free };
+    if (!nft) {
+        std::fprintf(stderr, "nft-set: no nftables context\n");
+        return 1;
+    }
+    // The JSON loop passes JSON documents, the table setup below still parses as text
+    nft_ctx_input_set_flags(nft.get(), NFT_CTX_INPUT_JSON);
+    nft_ctx_buffer_error(nft.get());
+    if (nft_run_cmd_from_buffer(nft.get(), "add table inet blueline_bench; add set inet blueline_bench addrs { type ipv4_addr; }") != 0) {
+        std::fprintf(stderr, "nft-set: can not create the bench table (needs CAP_NET_ADMIN): %s\n", nft_ctx_get_error_buffer(nft.get()));
+        return 1;
+    }
+
+    std::vector<std::string> none;
+    nft_set set("inet", "blueline_bench", "addrs", "ipv4_addr", none);
+    std::vector<ip4_prefix> prefixes;
+    std::vector<std::string> strings;
+    for (long i = 0; i < elements; i++) {
+        ip4_prefix prefix;
+        prefix.addr = htonl(0x0A630000u + static_cast<uint32_t>(i) + 1); // 10.99.0.1 upwards
+        prefixes.push_back(prefix);
+        strings.push_back(prefix.addr_str());
+    }
+
+    int failures = 0;
+    BenchStats json;
+    nft_root cmds;
+    for (long i = 0; i < updates; i++) {
+        const int64_t start = benchNowNs();
+        cmds.clear();
+        if (i % 2 == 0) {
+            set.cmd_add_element_json(strings, cmds);
+        } else {
+            set.cmd_delete_element_json(strings, cmds);
+        }
+        failures += nft_run_cmd_from_buffer(nft.get(), cmds.get_str().c_str()) != 0;
+        json.add(benchNowNs() - start);
+    }
+    if (updates % 2) {
+        nft_run_cmd_from_buffer(nft.get(), "flush set inet blueline_bench addrs");
+    }
+
+    BenchStats netlink;
+    nft_netlink_writer writer;
+    if (!writer.ok()) {
+        std::fprintf(stderr, "nft-set: no netlink socket\n");
+        failures++;
+    }
+    for (long i = 0; writer.ok() && i < updates; i++) {
+        const int64_t start = benchNowNs();
+        if (i % 2 == 0) {
+            writer.add_elements(set, prefixes);
+        } else {
+            writer.delete_elements(set, prefixes);
+        }
+        failures += !writer.commit();
+        netlink.add(benchNowNs() - start);
+    }
+
+    nft_run_cmd_from_buffer(nft.get(), "delete table inet blueline_bench");
+
+    std::printf("%ld elements per update\n", elements);
+    json.report("libnftables JSON");
+    netlink.report("netlink batch");
+    if (failures) {
+        std::fprintf(stderr, "nft-set: %d updates failed\n", failures);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,186 @@
+// PacketRateBench.cpp
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QTimer>
+#include <QUdpSocket>
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <pthread.h>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "Bench.h"
+#include "NetworkEngine.h"
+
+namespace {
+constexpr quint16 benchPort = 3190;
+
+/** @brief Floods 127.0.0.1:benchPort with sendmmsg from its own thread until stopped. */
+class Flooder
+{
+public:
+    explicit Flooder(size_t size) : payload(size, 'x') {
+        thread = std::thread([this]() { run(); });
+    }
+    ~Flooder() {
+        stopping = true;
+        thread.join();
+    }
+
+private:
+    void run() {
+        const int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        sockaddr_in target{};
+        target.sin_family = AF_INET;
+        target.sin_port = htons(benchPort);
+        target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        iovec packet = { payload.data(), payload.size() };
+        std::vector<mmsghdr> messages(64);
+        for (mmsghdr& message : messages) {
+            message.msg_hdr.msg_name = &target;
+            message.msg_hdr.msg_namelen = sizeof(target);
+            message.msg_hdr.msg_iov = &packet;
+            message.msg_hdr.msg_iovlen = 1;
+        }
+        while (!stopping) {
+            sendmmsg(fd, messages.data(), static_cast<unsigned int>(messages.size()), 0);
+        }
+        close(fd);
+    }
+
+    std::vector<char> payload;
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+};
+
+struct ReceiverResult {
+    quint64 packets = 0;
+    double seconds = 0;
+    double cpuSeconds = 0;
+};
+
+double cpuSeconds(clockid_t clock)
+{
+    timespec ts{};
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void report(const char* name, const ReceiverResult& result)
+{
+    if (result.packets == 0 || result.cpuSeconds <= 0) {
+        std::printf("%-12s no packets received\n", name);
+        return;
+    }
+    std::printf("%-12s %12.0f packets/s  %12.0f packets per CPU second  (receiving thread %3.0f %% busy)\n",
+                name, result.packets / result.seconds, result.packets / result.cpuSeconds,
+                100.0 * result.cpuSeconds / result.seconds);
+}
+
+bool runEngine(NetworkEngine::Backend backend, size_t size, int seconds, ReceiverResult& result)
+{
+    NetworkEngine engine(backend);
+    if (engine.backend() != backend || !engine.start()) {
+        return false;
+    }
+    std::atomic<quint64> packets{0};
+    std::atomic<bool> haveClock{false};
+    clockid_t engineClock{};
+    // The handler runs on the engine thread, which is the thread to account the CPU time of
+    const int socketId = engine.openUdp(QHostAddress::LocalHost, benchPort,
+        [&](const char*, size_t, const QHostAddress&, quint16) {
+            if (!haveClock.load(std::memory_order_relaxed)) {
+                pthread_getcpuclockid(pthread_self(), &engineClock);
+                haveClock.store(true, std::memory_order_release);
+            }
+            packets.fetch_add(1, std::memory_order_relaxed);
+        });
+    if (socketId < 0) {
+        return false;
+    }
+    Flooder flooder(size);
+    // Measure from the first packet on, the engine thread's clock starts mattering there
+    for (int waitedMs = 0; !haveClock.load(std::memory_order_acquire); waitedMs++) {
+        if (waitedMs == 1000) {
+            engine.closeSocket(socketId);
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const quint64 startPackets = packets.load();
+    const double startCpu = cpuSeconds(engineClock);
+    const int64_t start = benchNowNs();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    result.packets = packets.load() - startPackets;
+    result.cpuSeconds = cpuSeconds(engineClock) - startCpu;
+    result.seconds = (benchNowNs() - start) / 1e9;
+    engine.closeSocket(socketId);
+    return true;
+}
+
+bool runQUdpSocket(size_t size, int seconds, ReceiverResult& result)
+{
+    QUdpSocket socket;
+    if (!socket.bind(QHostAddress::LocalHost, benchPort)) {
+        return false;
+    }
+    quint64 packets = 0;
+    QByteArray datagram(static_cast<qsizetype>(size), 0);
+    QObject::connect(&socket, &QUdpSocket::readyRead, [&]() {
+        while (socket.hasPendingDatagrams()) {
+            socket.readDatagram(datagram.data(), datagram.size());
+            packets++;
+        }
+    });
+    Flooder flooder(size);
+    QEventLoop loop;
+    const double startCpu = cpuSeconds(CLOCK_THREAD_CPUTIME_ID);
+    const int64_t start = benchNowNs();
+    QTimer::singleShot(seconds * 1000, &loop, &QEventLoop::quit);
+    loop.exec();
+    result.packets = packets;
+    result.cpuSeconds = cpuSeconds(CLOCK_THREAD_CPUTIME_ID) - startCpu;
+    result.seconds = (benchNowNs() - start) / 1e9;
+    return true;
+}
+}
+
+// Receive rate of one UDP socket on loopback while another thread floods it. Packets per CPU
+// second of the receiving thread is the per-core figure; packets/s alone also depends on the sender.
+int runPacketRateBench(int argc, char* argv[])
+{
+    const size_t size = static_cast<size_t>(benchOption(argc, argv, "size", 200));
+    const int seconds = static_cast<int>(benchOption(argc, argv, "seconds", 3));
+
+    int qtArgc = 1;
+    char appName[] = "BluelineBench";
+    char* qtArgv[] = { appName, nullptr };
+    std::unique_ptr<QCoreApplication> app;
+    if (!QCoreApplication::instance()) {
+        app = std::make_unique<QCoreApplication>(qtArgc, qtArgv);
+    }
+
+    std::printf("%zu byte datagrams, %d s per receiver\n", size, seconds);
+    ReceiverResult result;
+    if (runEngine(NetworkEngine::Backend::IoUring, size, seconds, result)) {
+        report("io_uring", result);
+    } else {
+        std::printf("%-12s not available\n", "io_uring");
+    }
+    result = {};
+    if (runEngine(NetworkEngine::Backend::Epoll, size, seconds, result)) {
+        report("epoll", result);
+    } else {
+        std::printf("%-12s failed\n", "epoll");
+    }
+    result = {};
+    if (runQUdpSocket(size, seconds, result)) {
+        report("QUdpSocket", result);
+    } else {
+        std::printf("%-12s failed\n", "QUdpSocket");
+    }
+    return 0;
+}
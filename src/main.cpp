@@ -1,14 +1,68 @@
 // main.cpp
 #include "MainWindow.h"
 #include <QApplication>
+#include <QCommandLineParser>
+
+// Parses group:port[@interface], as given to --repeat-from and --repeat-to
+static bool parseStreamEndpoint(const QString& value, QHostAddress& group, quint16& port, QNetworkInterface& iface)
+{
+    const QStringList endpoint = value.split('@');
+    const QStringList address = endpoint.value(0).split(':');
+    bool portOk = false;
+    group = QHostAddress(address.value(0));
+    port = static_cast<quint16>(address.value(1).toUInt(&portOk));
+    if (endpoint.size() > 1) {
+        iface = QNetworkInterface::interfaceFromName(endpoint.value(1));
+        if (!iface.isValid()) {
+            return false;
+        }
+    }
+    return address.size() == 2 && group.isMulticast() && portOk && port != 0;
+}
 
 int main(int argc, char* argv[])
 {
     QApplication app(argc, argv);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption fileOption("file", "Stream a WAV or raw PCM file instead of the capture device.", "path");
+    QCommandLineOption rawFormatOption("raw-format", "Format of a raw PCM file as rate:channels, 16 bit (default 48000:2).", "format", "48000:2");
+    QCommandLineOption repeatFromOption("repeat-from", "Repeat the multicast stream group:port[@interface].", "endpoint");
+    QCommandLineOption repeatToOption("repeat-to", "Re-serve the repeated stream on group:port[@interface].", "endpoint");
+    QCommandLineOption repeatDelayOption("repeat-delay", "Jitter the repeater absorbs, in milliseconds (default 60).", "ms", "60");
+    parser.addOption(fileOption);
+    parser.addOption(rawFormatOption);
+    parser.addOption(repeatFromOption);
+    parser.addOption(repeatToOption);
+    parser.addOption(repeatDelayOption);
+    parser.process(app);
+
     NetworkManager networkManager;
     MainWindow mainWindow(&networkManager);
     mainWindow.show();
 
+    if (parser.isSet(fileOption)) {
+        const QStringList rawFormat = parser.value(rawFormatOption).split(':');
+        QAudioFormat format;
+        format.setSampleRate(rawFormat.value(0).toInt());
+        format.setChannelCount(rawFormat.value(1).toInt());
+        format.setSampleFormat(QAudioFormat::Int16);
+        if (!networkManager.startFileStreaming(parser.value(fileOption), format)) {
+            qWarning() << "Can not stream" << parser.value(fileOption);
+        }
+    }
+
+    if (parser.isSet(repeatFromOption) || parser.isSet(repeatToOption)) {
+        RepeaterConfig config;
+        config.targetDelayMs = parser.value(repeatDelayOption).toInt();
+        if (!parseStreamEndpoint(parser.value(repeatFromOption), config.upstreamGroup, config.upstreamPort, config.upstreamInterface)
+            || !parseStreamEndpoint(parser.value(repeatToOption), config.downstreamGroup, config.downstreamPort, config.downstreamInterface)) {
+            qWarning() << "--repeat-from and --repeat-to both need group:port[@interface]";
+        } else if (!networkManager.startRepeater(config)) {
+            qWarning() << "Can not repeat" << parser.value(repeatFromOption);
+        }
+    }
+
     return app.exec();
 }
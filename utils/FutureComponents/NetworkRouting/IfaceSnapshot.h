@@ -0,0 +1,251 @@
+#ifndef IFACESNAPSHOT_H
+#define IFACESNAPSHOT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <fcntl.h>
+#include <net/if.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "IpAddress.h"
+
+//! POSIX shared memory object holding the interface table published by ipmon
+static constexpr const char* iface_snapshot_name = "/ipmon.ifaces";
+
+/*! Layout of the shared memory object. Plain data only, so any process mapping it
+ *  sees the same table. Changes are published under a sequence lock: the writer makes
+ *  \c seq odd, rewrites the table and makes it even again; a reader copies what it
+ *  needs and retries if \c seq was odd or changed meanwhile. Readers never block the
+ *  writer and never write to the mapping. */
+struct iface_snapshot_shm {
+    static constexpr uint32_t magic_value = 0x49504d31;    // "IPM1"
+    static constexpr uint32_t max_ifaces = 64;
+    static constexpr uint32_t max_addrs = 16;
+
+    struct ip4_entry {
+        uint32_t addr;      //!< network byte order
+        uint8_t prefixlen;
+    };
+    struct ip6_entry {
+        uint8_t addr[16];
+        uint8_t prefixlen;
+    };
+    struct iface_entry {
+        char name[IF_NAMESIZE];
+        uint32_t ipv4_count;
+        uint32_t ipv6_count;
+        ip4_entry ipv4[max_addrs];
+        ip6_entry ipv6[max_addrs];
+    };
+
+    uint32_t magic;
+    //! Set when interfaces or addresses did not fit and were left out
+    uint32_t truncated;
+    //! Sequence lock, odd while the writer is changing the table
+    std::atomic<uint64_t> seq;
+    uint32_t iface_count;
+    iface_entry ifaces[max_ifaces];
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "seqlock must be address-free to be shared between processes");
+
+/*! Publishes the interface table of ipmon into \ref iface_snapshot_name. Only one writer may exist. */
+class iface_snapshot_writer
+{
+public:
+    iface_snapshot_writer() = default;
+    ~iface_snapshot_writer() {
+        if (_shm)
+            munmap(_shm, sizeof(iface_snapshot_shm));
+    }
+    iface_snapshot_writer(const iface_snapshot_writer&) = delete;
+    iface_snapshot_writer& operator=(const iface_snapshot_writer&) = delete;
+    /*! Creates or reuses the shared memory object, readable by everyone
+     * \return true on success */
+    bool open() {
+        if (_shm)
+            return true;
+        int fd = shm_open(iface_snapshot_name, O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        fchmod(fd, 0644);   // not limited by the umask
+        void* p = MAP_FAILED;
+        if (ftruncate(fd, sizeof(iface_snapshot_shm)) == 0)
+            p = mmap(nullptr, sizeof(iface_snapshot_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+            return false;
+        _shm = static_cast<iface_snapshot_shm*>(p);
+        // A table left by a previous ipmon keeps its sequence, so readers notice the next change;
+        // an odd one left by a crash is completed by the next publish()
+        if (_shm->magic != iface_snapshot_shm::magic_value) {
+            _shm->iface_count = 0;
+            _shm->seq.store(0, std::memory_order_relaxed);
+            _shm->magic = iface_snapshot_shm::magic_value;
+        }
+        return true;
+    }
+    /*! Replaces the published table with \c ifaces */
+    void publish(const ifaces_map& ifaces) {
+        if (!_shm)
+            return;
+        auto seq = _shm->seq.load(std::memory_order_relaxed) | 1;
+        _shm->seq.store(seq, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        uint32_t count = 0;
+        bool truncated = false;
+        for (auto& [name, a] : ifaces) {
+            if (count == iface_snapshot_shm::max_ifaces || name.size() >= IF_NAMESIZE) {
+                truncated = true;
+                continue;
+            }
+            auto& e = _shm->ifaces[count++];
+            memset(e.name, 0, sizeof(e.name));
+            memcpy(e.name, name.data(), name.size());
+            e.ipv4_count = e.ipv6_count = 0;
+            if (!a)
+                continue;
+            for (auto& ip : a->ipv4) {
+                if (e.ipv4_count == iface_snapshot_shm::max_addrs) {
+                    truncated = true;
+                    break;
+                }
+                e.ipv4[e.ipv4_count++] = { ip.addr, ip.prefixlen };
+            }
+            for (auto& ip : a->ipv6) {
+                if (e.ipv6_count == iface_snapshot_shm::max_addrs) {
+                    truncated = true;
+                    break;
+                }
+                auto& dst = e.ipv6[e.ipv6_count++];
+                memcpy(dst.addr, &ip.addr, sizeof(dst.addr));
+                dst.prefixlen = ip.prefixlen;
+            }
+        }
+        _shm->iface_count = count;
+        _shm->truncated = truncated;
+        _shm->seq.store(seq + 1, std::memory_order_release);
+    }
+private:
+    iface_snapshot_shm* _shm = nullptr;
+};
+
+/*! Reads the table published by ipmon. Lookups copy out of the mapping, so they cost a
+ *  memory read instead of an IPC round trip; they only retry while ipmon is writing. */
+class iface_snapshot_reader
+{
+public:
+    iface_snapshot_reader() = default;
+    ~iface_snapshot_reader() {
+        if (_shm)
+            munmap(const_cast<iface_snapshot_shm*>(_shm), sizeof(iface_snapshot_shm));
+    }
+    iface_snapshot_reader(const iface_snapshot_reader&) = delete;
+    iface_snapshot_reader& operator=(const iface_snapshot_reader&) = delete;
+    /*! Maps the table read-only
+     * \return false if ipmon has not published it */
+    bool open() {
+        if (_shm)
+            return true;
+        int fd = shm_open(iface_snapshot_name, O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        void* p = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(iface_snapshot_shm))
+            p = mmap(nullptr, sizeof(iface_snapshot_shm), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+            return false;
+        _shm = static_cast<const iface_snapshot_shm*>(p);
+        return true;
+    }
+    bool is_open() const { return _shm != nullptr; }
+    /*! \return number of changes published so far, to cheaply check for a newer table */
+    uint64_t generation() const {
+        return _shm ? _shm->seq.load(std::memory_order_acquire) / 2 : 0;
+    }
+    /*! \return copy of the whole table, nullopt if not open, not published yet or no
+     *  consistent copy could be taken; callers then fall back to asking the kernel */
+    std::optional<ifaces_map> snapshot() const {
+        std::optional<ifaces_map> result;
+        bool ok = read([&](const iface_snapshot_shm& shm) {
+            ifaces_map m;
+            for (uint32_t i = 0; i < std::min(shm.iface_count, iface_snapshot_shm::max_ifaces); i++)
+                m.emplace(entry_name(shm.ifaces[i]), std::make_shared<struct addrs>(entry_addrs(shm.ifaces[i])));
+            result = std::move(m);
+        });
+        if (!ok)
+            result.reset();
+        return result;
+    }
+    /*! \return addresses of interface \c ifname, nullopt if it is unknown or the table
+     *  could not be read, see snapshot() */
+    std::optional<struct addrs> find(const std::string& ifname) const {
+        std::optional<struct addrs> result;
+        bool ok = read([&](const iface_snapshot_shm& shm) {
+            result.reset();
+            for (uint32_t i = 0; i < std::min(shm.iface_count, iface_snapshot_shm::max_ifaces); i++) {
+                if (strncmp(shm.ifaces[i].name, ifname.c_str(), IF_NAMESIZE) == 0) {
+                    result = entry_addrs(shm.ifaces[i]);
+                    break;
+                }
+            }
+        });
+        if (!ok)
+            result.reset();
+        return result;
+    }
+private:
+    //! Attempts before read() gives up, a writer that died mid-update leaves \c seq odd forever
+    static constexpr int max_read_attempts = 1000;
+
+    /*! Runs \c copy until it observed a table that was not changed meanwhile.
+     *  \c copy must only copy data out, its result is discarded on retry.
+     *  \return false if nothing is published or no unchanged table was seen within
+     *  max_read_attempts; whatever \c copy produced is then unusable */
+    template <typename F>
+    bool read(F&& copy) const {
+        if (!_shm || _shm->magic != iface_snapshot_shm::magic_value)
+            return false;
+        for (int attempt = 0; attempt < max_read_attempts; attempt++) {
+            auto before = _shm->seq.load(std::memory_order_acquire);
+            if (before == 0)
+                return false;   // nothing published yet
+            if (before & 1) {
+                sched_yield();  // let the writer finish
+                continue;
+            }
+            copy(*_shm);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_shm->seq.load(std::memory_order_relaxed) == before)
+                return true;
+        }
+        return false;
+    }
+    static std::string entry_name(const iface_snapshot_shm::iface_entry& e) {
+        return std::string(e.name, strnlen(e.name, IF_NAMESIZE));
+    }
+    //! Copies one entry; counts are clamped since the writer may change them meanwhile
+    static struct addrs entry_addrs(const iface_snapshot_shm::iface_entry& e) {
+        struct addrs a;
+        for (uint32_t i = 0; i < std::min(e.ipv4_count, iface_snapshot_shm::max_addrs); i++)
+            a.ipv4.push_back({ e.ipv4[i].addr, e.ipv4[i].prefixlen });
+        for (uint32_t i = 0; i < std::min(e.ipv6_count, iface_snapshot_shm::max_addrs); i++) {
+            ip6_prefix p;
+            memcpy(&p.addr, e.ipv6[i].addr, sizeof(p.addr));
+            p.prefixlen = e.ipv6[i].prefixlen;
+            a.ipv6.push_back(p);
+        }
+        a.rebuild_networks();
+        return a;
+    }
+    const iface_snapshot_shm* _shm = nullptr;
+};
+
+#endif // IFACESNAPSHOT_H
@@ -0,0 +1,223 @@
+#ifndef IPADDRESS_H
+#define IPADDRESS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+//! \return netmask in network byte order for an IPv4 prefix length
+inline in_addr_t ip4_prefix_mask(unsigned prefixlen)
+{
+    return prefixlen == 0 ? 0 : htonl(~0u << (32 - std::min(prefixlen, 32u)));
+}
+
+//! \return prefix length of an IPv4 netmask given in network byte order
+inline unsigned ip4_mask_prefixlen(in_addr_t mask)
+{
+    return static_cast<unsigned>(__builtin_popcount(mask));
+}
+
+//! IPv4 address with prefix length, address in network byte order
+struct ip4_prefix {
+    in_addr_t addr = 0;
+    uint8_t prefixlen = 32;
+
+    //! \return the network this address belongs to
+    ip4_prefix network() const { return { addr & ip4_prefix_mask(prefixlen), prefixlen }; }
+    //! \return the address alone, e.g. 192.168.1.10
+    std::string addr_str() const {
+        char buf[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+        return buf;
+    }
+    //! \return the address in CIDR notation, e.g. 192.168.1.0/24
+    std::string cidr_str() const { return addr_str() + "/" + std::to_string(prefixlen); }
+
+    friend bool operator<(const ip4_prefix& a, const ip4_prefix& b) {
+        // Host order, so the sorted vectors list addresses numerically
+        const auto ha = ntohl(a.addr), hb = ntohl(b.addr);
+        return ha != hb ? ha < hb : a.prefixlen < b.prefixlen;
+    }
+    friend bool operator==(const ip4_prefix& a, const ip4_prefix& b) {
+        return a.addr == b.addr && a.prefixlen == b.prefixlen;
+    }
+    friend bool operator!=(const ip4_prefix& a, const ip4_prefix& b) { return !(a == b); }
+};
+
+//! IPv6 address with prefix length
+struct ip6_prefix {
+    struct in6_addr addr = IN6ADDR_ANY_INIT;
+    uint8_t prefixlen = 128;
+
+    //! \return the address alone, e.g. fe80::1
+    std::string addr_str() const {
+        char buf[INET6_ADDRSTRLEN];
+        inet_ntop(AF_INET6, &addr, buf, sizeof(buf));
+        return buf;
+    }
+    //! \return the address in CIDR notation, e.g. fe80::1/64
+    std::string cidr_str() const { return addr_str() + "/" + std::to_string(prefixlen); }
+
+    friend bool operator<(const ip6_prefix& a, const ip6_prefix& b) {
+        // Bytes are in network order, so memcmp orders numerically
+        const int c = memcmp(&a.addr, &b.addr, sizeof(a.addr));
+        return c != 0 ? c < 0 : a.prefixlen < b.prefixlen;
+    }
+    friend bool operator==(const ip6_prefix& a, const ip6_prefix& b) {
+        return memcmp(&a.addr, &b.addr, sizeof(a.addr)) == 0 && a.prefixlen == b.prefixlen;
+    }
+    friend bool operator!=(const ip6_prefix& a, const ip6_prefix& b) { return !(a == b); }
+};
+
+//! \return the addresses without prefix length, e.g. for nftables ipv4_addr sets
+template <typename T>
+std::vector<std::string> addr_strings(const std::vector<T>& v)
+{
+    std::vector<std::string> out;
+    out.reserve(v.size());
+    for (auto& a : v)
+        out.emplace_back(a.addr_str());
+    return out;
+}
+
+//! \return the addresses in CIDR notation
+template <typename T>
+std::vector<std::string> cidr_strings(const std::vector<T>& v)
+{
+    std::vector<std::string> out;
+    out.reserve(v.size());
+    for (auto& a : v)
+        out.emplace_back(a.cidr_str());
+    return out;
+}
+
+/*! Inserts \c value into the sorted vector \c v unless already present
+ * \return true if inserted */
+template <typename T>
+bool sorted_insert(std::vector<T>& v, const T& value)
+{
+    auto it = std::lower_bound(v.begin(), v.end(), value);
+    if (it != v.end() && *it == value)
+        return false;
+    v.insert(it, value);
+    return true;
+}
+
+/*! Removes \c value from the sorted vector \c v
+ * \return true if it was present */
+template <typename T>
+bool sorted_erase(std::vector<T>& v, const T& value)
+{
+    auto it = std::lower_bound(v.begin(), v.end(), value);
+    if (it == v.end() || *it != value)
+        return false;
+    v.erase(it);
+    return true;
+}
+
+//! Elements only in the new (\c added) or only in the old (\c removed) sorted vector
+template <typename T>
+struct addr_diff {
+    std::vector<T> added;
+    std::vector<T> removed;
+
+    bool empty() const { return added.empty() && removed.empty(); }
+};
+
+/*! Linear merge of two sorted vectors
+ * \param[in] before previous state
+ * \param[in] after current state */
+template <typename T>
+addr_diff<T> diff_sorted(const std::vector<T>& before, const std::vector<T>& after)
+{
+    addr_diff<T> d;
+    std::set_difference(after.begin(), after.end(), before.begin(), before.end(), std::back_inserter(d.added));
+    std::set_difference(before.begin(), before.end(), after.begin(), after.end(), std::back_inserter(d.removed));
+    return d;
+}
+
+/*! Addresses of one interface. All vectors are kept sorted and free of duplicates,
+ *  an interface without any address has all of them empty. */
+struct addrs {
+    std::vector<ip4_prefix> ipv4;
+    std::vector<ip6_prefix> ipv6;
+    //! Networks of \c ipv4, derived by \c rebuild_networks()
+    std::vector<ip4_prefix> ipv4_net;
+
+    //! Recomputes \c ipv4_net from \c ipv4
+    void rebuild_networks() {
+        ipv4_net.clear();
+        for (auto& a : ipv4)
+            ipv4_net.emplace_back(a.network());
+        std::sort(ipv4_net.begin(), ipv4_net.end());
+        ipv4_net.erase(std::unique(ipv4_net.begin(), ipv4_net.end()), ipv4_net.end());
+    }
+    bool empty() const { return ipv4.empty() && ipv6.empty(); }
+};
+
+//! Changes of one interface between two snapshots
+struct addrs_diff {
+    addr_diff<ip4_prefix> ipv4;
+    addr_diff<ip6_prefix> ipv6;
+    addr_diff<ip4_prefix> ipv4_net;
+    //! Interface appeared in the newer snapshot
+    bool iface_added = false;
+    //! Interface is missing from the newer snapshot
+    bool iface_removed = false;
+
+    bool empty() const { return ipv4.empty() && ipv6.empty() && ipv4_net.empty() && !iface_added && !iface_removed; }
+};
+
+inline addrs_diff diff_addrs(const addrs& before, const addrs& after)
+{
+    return { diff_sorted(before.ipv4, after.ipv4),
+             diff_sorted(before.ipv6, after.ipv6),
+             diff_sorted(before.ipv4_net, after.ipv4_net) };
+}
+
+using ifaces_map = std::unordered_map<std::string, std::shared_ptr<struct addrs>>;
+
+/*! Compares two interface snapshots
+ * \param[in] before previous snapshot
+ * \param[in] after current snapshot
+ * \return changes per interface name, interfaces without any change are left out */
+inline std::map<std::string, addrs_diff> diff_ifaces(const ifaces_map& before, const ifaces_map& after)
+{
+    static const addrs none{};
+    std::map<std::string, addrs_diff> changes;
+    for (auto& [name, a] : after) {
+        auto old = before.find(name);
+        auto d = diff_addrs(old != before.end() && old->second ? *old->second : none, a ? *a : none);
+        d.iface_added = old == before.end();
+        if (!d.empty())
+            changes.emplace(name, std::move(d));
+    }
+    for (auto& [name, a] : before) {
+        if (after.find(name) != after.end())
+            continue;
+        auto d = diff_addrs(a ? *a : none, none);
+        d.iface_removed = true;
+        changes.emplace(name, std::move(d));
+    }
+    return changes;
+}
+
+/*! Deep copy of a snapshot, so later changes of \c ifaces do not alter it */
+inline ifaces_map copy_ifaces(const ifaces_map& ifaces)
+{
+    ifaces_map copy;
+    copy.reserve(ifaces.size());
+    for (auto& [name, a] : ifaces)
+        copy.emplace(name, std::make_shared<struct addrs>(a ? *a : addrs{}));
+    return copy;
+}
+
+#endif // IPADDRESS_H
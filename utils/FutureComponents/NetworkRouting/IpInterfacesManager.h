@@ -3,20 +3,34 @@
 #include <unordered_map>
 #include <memory>
 
-#include "Ipmon.h"
+#include "IpAddress.h"
 
 class IpInterface
 {
 public:
-    IpInterface(const std::string& name, std::vector<std::string> ipv4, std::vector<std::string> ipv6, std::vector<std::string> ipv4_net)
-        : name(name), ipv4(ipv4), ipv6(ipv6), ipv4_net(ipv4_net)
+    IpInterface(const std::string& name, const struct addrs& addresses)
+        : name(name), addresses(addresses)
     {}
-    virtual ~IpInterface() override = default;
+    virtual ~IpInterface() = default;
+    const std::string& get_name() const { return name; }
+    const struct addrs& get_addrs() const { return addresses; }
+    //! \return IPv4 addresses as strings, e.g. 192.168.1.10
+    std::vector<std::string> ipv4_str() const { return addr_strings(addresses.ipv4); }
+    //! \return IPv6 addresses as strings
+    std::vector<std::string> ipv6_str() const { return addr_strings(addresses.ipv6); }
+    //! \return IPv4 networks in CIDR notation, e.g. 192.168.1.0/24
+    std::vector<std::string> ipv4_net_str() const { return cidr_strings(addresses.ipv4_net); }
+    /*! Replaces the stored addresses
+     * \return changes against the previously stored addresses */
+    addrs_diff set_addrs(const struct addrs& new_addresses) {
+        auto d = diff_addrs(addresses, new_addresses);
+        addresses = new_addresses;
+        return d;
+    }
 private:
     std::string name{};
-    std::vector<std::string> ipv4{};
-    std::vector<std::string> ipv6{};
-    std::vector<std::string> ipv4_net{};
+    //! Binary addresses, sorted
+    struct addrs addresses{};
 };
 
 class IpInterfacesManager
@@ -15,6 +15,9 @@
 #include <fstream>
 #include <signal.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
 #include <getopt.h>
 #include <optional>
 #include <algorithm>
@@ -50,7 +53,7 @@ void ipmon::help()
 
 ipmon::ipmon()
 {
-    _socket_server_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    _socket_server_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (_socket_server_fd == -1) {
         std::cerr << "SOCKET ERROR: " <<  strerror(errno) << std::endl;
         exit(EXIT_FAILURE);
@@ -66,6 +69,11 @@ ipmon::ipmon()
         close(_socket_server_fd);
         exit(EXIT_FAILURE);
     }
+    _event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_event_fd == -1) {
+        std::cerr << "EVENTFD ERROR: " <<  strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
 }
 
 bool ipmon::init_socket()
@@ -73,35 +81,6 @@ bool ipmon::init_socket()
     return true;
 }
 
-void ipmon::listen_socket()
-{
-    while (true)
-    {
-        struct sockaddr_un peer_sock;
-        memset(&peer_sock, 0, sizeof(struct sockaddr_un));
-        socklen_t peer_len = sizeof(peer_sock);
-        char buf[256];
-        const auto& peer_sock_p = reinterpret_cast<struct sockaddr*> (&peer_sock);
-        if (auto bytes_read = recvfrom(_socket_server_fd, buf, 256, MSG_WAITALL, peer_sock_p, &peer_len);
-            bytes_read != -1)
-        {
-            //std::this_thread::sleep_for(std::chrono::milliseconds(2000));
-            if (auto buf_view = std::string_view(buf, bytes_read);
-                buf_view == sockserver_cmds.at(sockserver_cmd::reload) ) {
-                reload();
-                if (sendto(_socket_server_fd, nullptr, 0, 0, peer_sock_p, sizeof(peer_sock)) == -1) {
-                    Logger("Listening socket reply error(sendto): ");
-                }
-            } else if (buf_view == sockserver_cmds.at(sockserver_cmd::update) ) {
-                update();
-            }
-            std::this_thread::sleep_for(std::chrono::microseconds(250'000));
-        } else if (errno !=  EAGAIN && errno != EWOULDBLOCK) {
-            Logger("Listening socket error(recvfrom): ");
-        }
-    }
-}
-
 void ipmon::process_cmdline(int argc, char* argv[])
 {
     struct option long_options[] =
@@ -161,11 +140,16 @@ void ipmon::process_cmdline(int argc, char* argv[])
 
 void ipmon::update()
 {
-    get_if_addresses();
+    // _ifaces is kept current from netlink deltas, no rescan needed
+    auto changes = diff_ifaces(_published, _ifaces);
+    if (changes.empty())
+        return;     // e.g. an address was added and removed again within the debounce delay
     if (_opt_nftables)
         tell_nftables();
     if (_opt_monitor)
-        print();
+        print_changes(changes);
+    _published = copy_ifaces(_ifaces);
+    _snapshot.publish(_published);
 }
 
 void ipmon::reload()
@@ -175,6 +159,8 @@ void ipmon::reload()
         tell_nftables();
     if (_opt_monitor)
         print();
+    _published = copy_ifaces(_ifaces);
+    _snapshot.publish(_published);
 }
 
 void ipmon::print()
@@ -182,166 +168,373 @@ void ipmon::print()
     for (auto p = _ifaces.begin(); p != _ifaces.end(); p++) {
         std::cout << "Interface: " << p->first << " IPv4: ";
         for (auto& vec : p->second->ipv4)
-            std::cout <<  vec << " ";
+            std::cout <<  vec.addr_str() << " ";
         std::cout << "IPv4_networks: ";
         for (auto& vec : p->second->ipv4_net)
-            std::cout <<  vec << " ";
+            std::cout <<  vec.cidr_str() << " ";
         std::cout << "IPv6: ";
         for (auto& vec : p->second->ipv6)
-            std::cout <<  vec << " ";
+            std::cout <<  vec.addr_str() << " ";
+        std::cout << std::endl;
+    }
+}
+
+void ipmon::print_changes(const std::map<std::string, addrs_diff>& changes)
+{
+    auto print_list = [](const char* label, const auto& list) {
+        if (list.empty())
+            return;
+        std::cout << label;
+        for (auto& a : list)
+            std::cout << a.cidr_str() << " ";
+    };
+    for (auto& [name, d] : changes) {
+        std::cout << "Interface: " << name;
+        if (d.iface_added)
+            std::cout << " (new)";
+        if (d.iface_removed)
+            std::cout << " (removed)";
+        print_list(" +IPv4: ", d.ipv4.added);
+        print_list(" -IPv4: ", d.ipv4.removed);
+        print_list(" +IPv4_networks: ", d.ipv4_net.added);
+        print_list(" -IPv4_networks: ", d.ipv4_net.removed);
+        print_list(" +IPv6: ", d.ipv6.added);
+        print_list(" -IPv6: ", d.ipv6.removed);
         std::cout << std::endl;
     }
 }
 
 void ipmon::run()
 {
-    _netlink_fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
-    while (_netlink_fd < 0) {
-        Logger("Failed to create netlink socket: ");
+    // Shortages and a previous instance's socket going away are worth waiting for; anything
+    // else (EMFILE, EPERM, ...) will not change, give up instead of retrying forever
+    constexpr int max_setup_attempts = 40; // 10 s at 250 ms
+    auto retry_setup = [](int error, int attempt) {
+        if (attempt >= max_setup_attempts || (error != ENOBUFS && error != ENOMEM && error != EADDRINUSE))
+            exit(EXIT_FAILURE);
         std::this_thread::sleep_for(std::chrono::microseconds(250'000));
-        _netlink_fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+    };
+    _netlink_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    for (int attempt = 1; _netlink_fd < 0; attempt++) {
+        const int error = errno;
+        Logger("Failed to create netlink socket: ");
+        retry_setup(error, attempt);
+        _netlink_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
     }
-    char buf[16384];
-    struct iovec iov;
-    iov.iov_base = buf;
-    iov.iov_len = sizeof(buf);
     struct sockaddr_nl  local;
     memset(&local, 0, sizeof(local));
     local.nl_family = AF_NETLINK;
-    local.nl_groups = RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    local.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
     local.nl_pid = getpid();
-    struct msghdr msg =
-    {
-        msg.msg_name = &local,
-        msg.msg_namelen = sizeof(local),
-        msg.msg_iov = &iov,
-        msg.msg_iovlen = 1,
-        msg.msg_control = nullptr,
-        msg.msg_controllen = 0,
-        msg.msg_flags = 0,
-    };
-    while (bind(_netlink_fd, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0) {
-        Logger("Failed to bind netlink socket.");
+    for (int attempt = 1; bind(_netlink_fd, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0; attempt++) {
+        const int error = errno;
+        Logger("Failed to bind netlink socket: ");
+        retry_setup(error, attempt);
     }
-    bool timer_ticking = false;
-    std::chrono::_V2::steady_clock::time_point timer_delay;
+    // Full scan once subscribed, from here on _ifaces follows the netlink deltas
+    resync();
+    if (_snapshot.open())
+        _snapshot.publish(_ifaces);
+    else
+        Logger("Failed to create shared memory snapshot " + std::string(iface_snapshot_name) + ": ");
+    _timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_timer_fd < 0 || _epoll_fd < 0) {
+        Logger("Failed to create event loop: ");
+        exit(EXIT_FAILURE);
+    }
+    for (int fd : {_netlink_fd, _socket_server_fd, _timer_fd, _event_fd}) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            Logger("Failed to register descriptor in epoll: ");
+            exit(EXIT_FAILURE);
+        }
+    }
+    // Sleeps in epoll_wait() until netlink or the control socket has a message, the debounce timer
+    // expires or trigger() was called
+    struct epoll_event events[4];
     while (true)
     {
-        ssize_t status = recvmsg(_netlink_fd, &msg, MSG_DONTWAIT);
-        if (timer_ticking)
-        {
-            auto time_left = std::chrono::duration_cast<std::chrono::microseconds>
-                            (std::chrono::steady_clock::now() - timer_delay).count();
-            if (time_left >= _delay.count())
-            {
-                timer_ticking = false;
-                socket_action(sockserver_cmd::update);
+        int count = epoll_wait(_epoll_fd, events, sizeof(events) / sizeof(events[0]), -1);
+        if (count < 0) {
+            if (errno != EINTR)
+                Logger("Error: epoll_wait: ");
+            continue;
+        }
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd == _netlink_fd) {
+                read_netlink(local);
+            } else if (events[i].data.fd == _socket_server_fd) {
+                read_socket_server();
+            } else if (events[i].data.fd == _timer_fd) {
+                uint64_t expirations;
+                if (read(_timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                    _timer_ticking = false;
+                    _pending_update = true;
+                }
+            } else if (events[i].data.fd == _event_fd) {
+                read_triggers();
             }
         }
+        run_pending();
+    }
+}
+
+void ipmon::read_netlink(const struct sockaddr_nl& local)
+{
+    char buf[16384];
+    struct iovec iov;
+    iov.iov_base = buf;
+    iov.iov_len = sizeof(buf);
+    struct sockaddr_nl sender;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &sender;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    while (true)
+    {
+        msg.msg_namelen = sizeof(sender);
+        ssize_t status = recvmsg(_netlink_fd, &msg, MSG_DONTWAIT);
         if (status < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                std::this_thread::sleep_for(std::chrono::microseconds(250'000));
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return;
+            if (errno == EINTR)
+                continue;
+            if (errno == ENOBUFS) {
+                // Messages were lost, the deltas can not be trusted anymore
+                Logger("Netlink overrun, rescanning interfaces: ");
+                resync();
+                arm_debounce_timer();
                 continue;
             }
             Logger("Error: netlink receive error: ");
-            continue;
+            return;
         } else if (status == 0) {
             Logger("Error: EOF on netlink.");
-            continue;
+            return;
         } else if (msg.msg_namelen != sizeof(local)) {
             Logger("Error: Invalid netlink sender address length = " + std::to_string(msg.msg_namelen));
             continue;
-        } else {
-            if (_opt_monitor)
-                    parse_netlink_msg(status, reinterpret_cast<struct nlmsghdr*>(buf));
-            if (!timer_ticking)
-            {
-                timer_ticking = true;
-                timer_delay = std::chrono::steady_clock::now();
-                continue;
-            }
         }
+        parse_netlink_msg(status, reinterpret_cast<struct nlmsghdr*>(buf));
+        arm_debounce_timer();
     }
 }
 
-void ipmon::parse_netlink_msg(ssize_t status, struct nlmsghdr* buf)
+void ipmon::read_socket_server()
 {
-    struct nlmsghdr *h;
-    for (h = buf; status >= static_cast<ssize_t>(sizeof(*h)); ) {
-        int len = h->nlmsg_len;
-        int l = len - sizeof(*h);
-        if ((l < 0) || (len > status)) {
-            std::cerr << "Error: Invalid message length: " << len << std::endl;
+    while (true)
+    {
+        reply_peer p;
+        memset(&p.addr, 0, sizeof(p.addr));
+        p.len = sizeof(p.addr);
+        char buf[256];
+        auto bytes_read = recvfrom(_socket_server_fd, buf, sizeof(buf), MSG_DONTWAIT,
+                                   reinterpret_cast<struct sockaddr*>(&p.addr), &p.len);
+        if (bytes_read < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                Logger("Listening socket error(recvfrom): ");
             break;
         }
-        struct ifaddrmsg *ifa;
-        struct rtattr *tba[IFA_MAX+1];
-        ifa = static_cast<struct ifaddrmsg*>(NLMSG_DATA(h));
-        auto rta = IFA_RTA(ifa);
-        memset(tba, 0, sizeof(struct rtattr *) * (IFA_MAX + 1));
-        while (RTA_OK(rta, h->nlmsg_len)) {
-            if (rta->rta_type <= IFA_MAX) {
-                tba[rta->rta_type] = rta;
-            }
-            rta = RTA_NEXT(rta,h->nlmsg_len);
-        }
-        char if_addr[256];
-        char if_name[IFNAMSIZ];
-        if (ifa->ifa_index == 0 || if_indextoname(ifa->ifa_index, if_name) == nullptr) {
-            std::cerr << "Error: No interface name." << std::endl;
-            status -= NLMSG_ALIGN(len);
-            h = reinterpret_cast<struct nlmsghdr *>(reinterpret_cast<char *>(h) + NLMSG_ALIGN(len));
+        auto buf_view = std::string_view(buf, bytes_read);
+        if (buf_view == sockserver_cmds.at(sockserver_cmd::reload))
+            _pending_reload = true;
+        else if (buf_view == sockserver_cmds.at(sockserver_cmd::update))
+            _pending_update = true;
+        else
             continue;
-        }
-        if (ifa->ifa_family == AF_INET) {
-            if (!tba[IFA_ADDRESS]) {
-                if (!tba[IFA_LOCAL]) {
-                    std::cerr << "Error: No address obtained for interface " << if_name << std:: endl;
-                    status -= NLMSG_ALIGN(len);
-                    h = reinterpret_cast<struct nlmsghdr *>(reinterpret_cast<char *>(h) + NLMSG_ALIGN(len));
-                    continue;
-                }
-                inet_ntop(AF_INET, RTA_DATA(tba[IFA_LOCAL]), if_addr, sizeof(if_addr));
-            }
-            inet_ntop(AF_INET, RTA_DATA(tba[IFA_ADDRESS]), if_addr, sizeof(if_addr));
-        } else {            // AF_INET6
-            if (!tba[IFA_ADDRESS]) {
-                std::cerr << "Error: No address obtained for interface " << if_name << std::endl;
-                status -= NLMSG_ALIGN(len);
-                h = reinterpret_cast<struct nlmsghdr *>(reinterpret_cast<char *>(h) + NLMSG_ALIGN(len));
-                continue;
-            }
-            inet_ntop(AF_INET6, RTA_DATA(tba[IFA_ADDRESS]), if_addr, sizeof(if_addr));
-        }
+        // Unbound senders (e.g. socket_action()) can not receive a reply
+        if (p.len > sizeof(sa_family_t))
+            _reply_peers.push_back(p);
+    }
+}
+
+void ipmon::trigger(sockserver_cmd action)
+{
+    _triggered.fetch_or(1u << static_cast<unsigned>(action), std::memory_order_release);
+    uint64_t one = 1;
+    if (write(_event_fd, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN)
+        Logger("Failed to signal event loop: ");
+}
+
+void ipmon::read_triggers()
+{
+    uint64_t count;
+    if (read(_event_fd, &count, sizeof(count)) != sizeof(count))
+        return;
+    auto triggered = _triggered.exchange(0, std::memory_order_acquire);
+    if (triggered & (1u << static_cast<unsigned>(sockserver_cmd::update)))
+        _pending_update = true;
+    if (triggered & (1u << static_cast<unsigned>(sockserver_cmd::reload)))
+        _pending_reload = true;
+}
+
+void ipmon::run_pending()
+{
+    // A reload includes everything an update does
+    if (_pending_reload)
+        reload();
+    else if (_pending_update)
+        update();
+    _pending_reload = false;
+    _pending_update = false;
+    for (auto& p : _reply_peers) {
+        if (sendto(_socket_server_fd, nullptr, 0, MSG_DONTWAIT, reinterpret_cast<struct sockaddr*>(&p.addr), p.len) == -1)
+            Logger("Listening socket reply error(sendto): ");
+    }
+    _reply_peers.clear();
+}
+
+void ipmon::arm_debounce_timer()
+{
+    if (_timer_ticking)
+        return;
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = _delay.count() / 1'000'000;
+    its.it_value.tv_nsec = (_delay.count() % 1'000'000) * 1000;
+    if (timerfd_settime(_timer_fd, 0, &its, nullptr) < 0) {
+        Logger("Failed to arm debounce timer: ");
+        return;
+    }
+    _timer_ticking = true;
+}
+
+void ipmon::resync()
+{
+    get_if_addresses();
+}
+
+void ipmon::parse_netlink_msg(ssize_t status, struct nlmsghdr* buf)
+{
+    for (auto h = buf; NLMSG_OK(h, status); h = NLMSG_NEXT(h, status)) {
         switch (h->nlmsg_type) {
             case RTM_NEWADDR:
-                std::cout << "[NETLINK]: New address assigned to interface "
-                                << if_name << ": " << if_addr << std:: endl;
-                break;
             case RTM_DELADDR:
-                std::cout << "[NETLINK]: Address was removed from interface "
-                                << if_name << ": " << if_addr << std:: endl;
+                parse_addr_msg(h);
+                break;
+            case RTM_NEWLINK:
+            case RTM_DELLINK:
+                parse_link_msg(h);
+                break;
+            case NLMSG_ERROR:
+                std::cerr << "Error: netlink error message." << std::endl;
                 break;
         }
-        status -= NLMSG_ALIGN(len);
-        h = reinterpret_cast<struct nlmsghdr *>(reinterpret_cast<char *>(h) + NLMSG_ALIGN(len));
     }
+    if (status > 0)
+        std::cerr << "Error: Invalid message length, " << status << " bytes left." << std::endl;
 }
 
-std::string network_addr_str(in_addr_t addr, in_addr_t mask) {
-    char netAddrBuffer[INET_ADDRSTRLEN];
-    auto addr_and_mask = addr & mask;
-    inet_ntop(
-        AF_INET,
-        &addr_and_mask,
-        netAddrBuffer,
-        INET_ADDRSTRLEN);
-    unsigned int count = 0;
-    while (mask) {
-        count += mask & 1;
-        mask >>= 1;
-    }
-    return std::string(netAddrBuffer) + "/" + std::to_string(count);
+void ipmon::parse_addr_msg(struct nlmsghdr* h)
+{
+    auto ifa = static_cast<struct ifaddrmsg*>(NLMSG_DATA(h));
+    struct rtattr *tba[IFA_MAX+1] = {};
+    int attr_len = IFA_PAYLOAD(h);
+    for (auto rta = IFA_RTA(ifa); RTA_OK(rta, attr_len); rta = RTA_NEXT(rta, attr_len)) {
+        if (rta->rta_type <= IFA_MAX)
+            tba[rta->rta_type] = rta;
+    }
+    if (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6)
+        return;
+    auto if_name = iface_name(ifa->ifa_index);
+    if (!if_name) {
+        std::cerr << "Error: No interface name." << std::endl;
+        return;
+    }
+    // For IPv4 IFA_LOCAL is the local address, IFA_ADDRESS may be the peer of a point-to-point link
+    auto addr_attr = (ifa->ifa_family == AF_INET && tba[IFA_LOCAL]) ? tba[IFA_LOCAL] : tba[IFA_ADDRESS];
+    if (!addr_attr) {
+        std::cerr << "Error: No address obtained for interface " << *if_name << std:: endl;
+        return;
+    }
+    const bool added = h->nlmsg_type == RTM_NEWADDR;
+    apply_addr_change(added, *if_name, ifa->ifa_family, RTA_DATA(addr_attr), ifa->ifa_prefixlen);
+    if (_opt_monitor) {
+        char if_addr[INET6_ADDRSTRLEN];
+        inet_ntop(ifa->ifa_family, RTA_DATA(addr_attr), if_addr, sizeof(if_addr));
+        if (added)
+            std::cout << "[NETLINK]: New address assigned to interface "
+                            << *if_name << ": " << if_addr << std:: endl;
+        else
+            std::cout << "[NETLINK]: Address was removed from interface "
+                            << *if_name << ": " << if_addr << std:: endl;
+    }
+}
+
+void ipmon::parse_link_msg(struct nlmsghdr* h)
+{
+    auto ifi = static_cast<struct ifinfomsg*>(NLMSG_DATA(h));
+    const char* link_name = nullptr;
+    int attr_len = IFLA_PAYLOAD(h);
+    for (auto rta = IFLA_RTA(ifi); RTA_OK(rta, attr_len); rta = RTA_NEXT(rta, attr_len)) {
+        if (rta->rta_type == IFLA_IFNAME)
+            link_name = static_cast<const char*>(RTA_DATA(rta));
+    }
+    auto known = _ifnames.find(ifi->ifi_index);
+    if (h->nlmsg_type == RTM_DELLINK) {
+        if (known != _ifnames.end()) {
+            _ifaces.erase(known->second);
+            _ifnames.erase(known);
+        }
+        if (_opt_monitor && link_name)
+            std::cout << "[NETLINK]: Interface removed: " << link_name << std::endl;
+        return;
+    }
+    if (!link_name)
+        return;
+    if (known != _ifnames.end() && known->second != link_name) {
+        // Renamed, keep its addresses under the new name
+        auto node = _ifaces.extract(known->second);
+        if (!node.empty()) {
+            node.key() = link_name;
+            _ifaces.insert(std::move(node));
+        }
+    }
+    _ifnames[ifi->ifi_index] = link_name;
+    if (_ifaces.find(link_name) == _ifaces.end())
+        _ifaces.emplace(link_name, std::make_shared<struct addrs>());
+}
+
+std::optional<std::string> ipmon::iface_name(int ifindex)
+{
+    if (auto it = _ifnames.find(ifindex); it != _ifnames.end())
+        return it->second;
+    char if_name[IF_NAMESIZE];
+    if (ifindex == 0 || if_indextoname(ifindex, if_name) == nullptr)
+        return std::nullopt;
+    _ifnames[ifindex] = if_name;
+    return std::string(if_name);
+}
+
+void ipmon::apply_addr_change(bool added, const std::string& ifname, int family, const void* addr, unsigned prefixlen)
+{
+    auto& entry = _ifaces[ifname];
+    if (!entry)
+        entry = std::make_shared<struct addrs>();
+    auto& a = *entry;
+    if (family == AF_INET) {
+        ip4_prefix p;
+        memcpy(&p.addr, addr, sizeof(p.addr));
+        p.prefixlen = static_cast<uint8_t>(prefixlen);
+        // A network stays while another address of the interface is still in it
+        if (added ? sorted_insert(a.ipv4, p) : sorted_erase(a.ipv4, p))
+            a.rebuild_networks();
+    } else {
+        ip6_prefix p;
+        memcpy(&p.addr, addr, sizeof(p.addr));
+        p.prefixlen = static_cast<uint8_t>(prefixlen);
+        if (added)
+            sorted_insert(a.ipv6, p);
+        else
+            sorted_erase(a.ipv6, p);
+    }
 }
 
 void ipmon::get_if_addresses()
@@ -351,48 +544,39 @@ void ipmon::get_if_addresses()
 
     getifaddrs(&interface_list);
     _ifaces.clear();
-    std::vector<char*> tmp_ifaces{};
+    _ifnames.clear();
     for (ifa = interface_list; ifa != nullptr; ifa = ifa->ifa_next) {
-        if (ifa->ifa_name) {
-            tmp_ifaces.emplace_back(ifa->ifa_name);
+        if (!ifa->ifa_name) {
+            continue;
         }
+        // Interfaces without any address are listed too, with empty address lists
+        auto& entry = _ifaces[ifa->ifa_name];
+        if (!entry)
+            entry = std::make_shared<struct addrs>();
         if (!ifa->ifa_addr) {
             continue;
         }
         if (ifa->ifa_addr->sa_family == AF_INET) {
-            auto binary_addr_ptr= &reinterpret_cast<struct sockaddr_in *>(ifa->ifa_addr)->sin_addr;
-            auto binary_mask_ptr = &reinterpret_cast<struct sockaddr_in *>(ifa->ifa_netmask)->sin_addr;
-            auto net_addr_s = network_addr_str(binary_addr_ptr->s_addr, binary_mask_ptr->s_addr);
-            char addressBuffer[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, binary_addr_ptr, addressBuffer, INET_ADDRSTRLEN);
-            if (auto find_it = _ifaces.find(ifa->ifa_name); find_it != _ifaces.end()) {
-                find_it->second->ipv4.emplace_back(std::string(addressBuffer));
-                auto& nets = find_it->second->ipv4_net;
-                if (std::find(nets.begin(), nets.end(), net_addr_s ) == nets.end())
-                    nets.emplace_back(net_addr_s);
-            } else {
-                struct addrs new_addrs = { {std::string(addressBuffer)}, {}, {net_addr_s} };
-                _ifaces.emplace(std::make_pair(std::string(ifa->ifa_name),
-                    std::make_shared<struct addrs>(new_addrs)));
-            }
+            ip4_prefix p;
+            p.addr = reinterpret_cast<struct sockaddr_in *>(ifa->ifa_addr)->sin_addr.s_addr;
+            if (ifa->ifa_netmask)
+                p.prefixlen = ip4_mask_prefixlen(reinterpret_cast<struct sockaddr_in *>(ifa->ifa_netmask)->sin_addr.s_addr);
+            sorted_insert(entry->ipv4, p);
         } else if (ifa->ifa_addr->sa_family == AF_INET6) {
-            auto binary_addr_ptr=&reinterpret_cast<struct sockaddr_in6 *>(ifa->ifa_addr)->sin6_addr;
-            char addressBuffer[INET6_ADDRSTRLEN];
-            inet_ntop(AF_INET6, binary_addr_ptr, addressBuffer, INET6_ADDRSTRLEN);
-            if (auto find_it = _ifaces.find(ifa->ifa_name); find_it != _ifaces.end()) {
-                find_it->second->ipv6.emplace_back(std::string(addressBuffer));
-            } else {
-                struct addrs new_addrs = { {}, {std::string(addressBuffer)}, {} };
-                _ifaces.emplace(std::make_pair(std::string(ifa->ifa_name),
-                    std::make_shared<struct addrs>(new_addrs)));
+            ip6_prefix p;
+            p.addr = reinterpret_cast<struct sockaddr_in6 *>(ifa->ifa_addr)->sin6_addr;
+            if (ifa->ifa_netmask) {
+                unsigned prefixlen = 0;
+                auto mask = reinterpret_cast<struct sockaddr_in6 *>(ifa->ifa_netmask)->sin6_addr.s6_addr;
+                for (int i = 0; i < 16; i++)
+                    prefixlen += __builtin_popcount(mask[i]);
+                p.prefixlen = static_cast<uint8_t>(prefixlen);
             }
+            sorted_insert(entry->ipv6, p);
         }
     }
-    for (auto& tmp : tmp_ifaces)    // sets null addresses only if both IPv4 and IPv6 are empty
-        if (_ifaces.find(tmp) == _ifaces.end()) {
-            struct addrs empty_addrs = { {"0.0.0.0"}, {"::"}, {"0.0.0.0"} };
-            _ifaces.emplace(std::make_pair(std::string(tmp), std::make_shared<struct addrs>(empty_addrs)));
-        }
+    for (auto& iface : _ifaces)
+        iface.second->rebuild_networks();
     if (interface_list != nullptr) freeifaddrs(interface_list);
 }
 
@@ -463,8 +647,6 @@ int main(int argc, char* argv[]) {
     ipmon ipm;
     ipm.process_cmdline(argc, argv);
     ipm.start();
-    auto listen_thread = std::thread(&ipmon::listen_socket, &ipm);
-    listen_thread.detach();
     ipm.run();
 
     return 0;
@@ -6,16 +6,15 @@
 #include <sstream>
 #include <sys/un.h>
 #include <sys/socket.h>
+#include <linux/netlink.h>
 #include <thread>
+#include <atomic>
 #include <map>
+#include <optional>
+#include "IpAddress.h"
+#include "IfaceSnapshot.h"
 #include "IpInterfacesManager.h"
 
-struct addrs {
-    std::vector<std::string> ipv4;
-    std::vector<std::string> ipv6;
-    std::vector<std::string> ipv4_net;
-};
-
 /*! The ipmon, of which only one instance should exist.
  *  Maybe will be transformed to singleon.
  */
@@ -37,6 +36,9 @@ public:
     ~ipmon() {
         close(_netlink_fd);
         close(_socket_server_fd);
+        close(_timer_fd);
+        close(_event_fd);
+        close(_epoll_fd);
     }
     //! Prints a help message.
     void help();
@@ -47,6 +49,7 @@ public:
     /*! Calls \c update() immediately if \c _opt_start is set. Should be called before \c run() */
     void start() {
         if (_opt_start) {
+            resync();
             update();
             _opt_start = false;
         }
@@ -54,7 +57,8 @@ public:
     /*! Starts monitoring netlink socket for address related messages. Upon message arrival,
      *  a timer with duration of \c _delay is set. After that time message is processed.
      *  Reading from socket continues, and if \c _opt_monitor is set, every message is parsed by \c parse_netlink_msg()
-     *  Timer is reset in SIGALRM handling function \c update() */
+     *  The loop blocks in epoll_wait() on the netlink socket, the \c _socket_server_fd control socket
+     *  and the \c _timer_fd debounce timer, so it reacts to events immediately and does not wake up while idle. */
     void run();
     /*! Prints information about network interfaces and addresses */
     void print();
@@ -66,8 +70,10 @@ public:
     struct sockaddr* socket_server_addr_p() { return reinterpret_cast<struct sockaddr*>(&_socket_server_addr); }
     /*! \return whether the socket initialization at  \c _socket_server_path was successful or not.*/
     bool init_socket();
-    /*! Unix socket server listening on \c _socket_server_path accepting requests defined in \c sockserver_cmds */
-    void listen_socket();
+    /*! Requests \c action from within the process. Safe to call from any thread; the action runs
+     *  in the \c run() loop, coalesced with other requests, without any socket being involved.
+     * \param[in] action action to run */
+    void trigger(sockserver_cmd action);
     /*! Sends a message to unix domain socket listening on \ref _socket_server_addr.
      * \param[in] action message for the server
      * \return true on success, false otherwise */
@@ -77,10 +83,37 @@ public:
     bool is_iface_loopback(const std::string& ifname);
 private:
     int _socket_server_fd;
-    int _netlink_fd;
+    int _netlink_fd = -1;
+    //! epoll instance driving \c run()
+    int _epoll_fd = -1;
+    //! timerfd implementing the \c _delay debounce
+    int _timer_fd = -1;
+    //! Whether \c _timer_fd is armed
+    bool _timer_ticking = false;
+    //! eventfd waking \c run() up for \c trigger()
+    int _event_fd = -1;
+    //! Actions requested by \c trigger(), one bit per \c sockserver_cmd
+    std::atomic<unsigned> _triggered{0};
+    //! An update was requested since the last one was run
+    bool _pending_update = false;
+    //! A reload was requested since the last one was run
+    bool _pending_reload = false;
+    //! Address of a control socket client waiting for a reply
+    struct reply_peer {
+        struct sockaddr_un addr;
+        socklen_t len;
+    };
+    //! Clients to reply to once the pending actions ran
+    std::vector<reply_peer> _reply_peers;
     struct sockaddr_un _socket_server_addr;
-    //! Stored interface names and addresses
-    std::unordered_map<std::string, std::shared_ptr<struct addrs>> _ifaces;
+    //! Stored interface names and addresses, maintained from netlink deltas
+    ifaces_map _ifaces;
+    //! Copy of \c _ifaces as of the last \c update() or \c reload(), base of the next diff
+    ifaces_map _published;
+    //! Shared memory copy of \c _published for other local processes
+    iface_snapshot_writer _snapshot;
+    //! Interface index to name, so that deltas need no if_indextoname() call
+    std::unordered_map<int, std::string> _ifnames;
     static constexpr const char* _socket_server_path = "/run/ipmon.sock";
     //! Whether to flush and reload nftables configuration upon any address of any device had changed
     bool _opt_flush = false;
@@ -91,17 +124,47 @@ private:
     //! Time for which related messages should be ignored
     std::chrono::microseconds _delay {200'000};
     /*! Called from \c start() and after receiving IPv4/IPv6 address-related message from netlink.
-     *  Obtains current interface information and updates served components. */
+     *  Diffs \c _ifaces against \c _published and updates served components only if anything changed. */
     void update();
     /*! Action performed based on \c sockserver_cmd::reload command coming from outside.
      *  Obtains current interface information and updates served components. Reloads the whole nft configuration */
     void reload();
-    /*! Called from \c run() to parse netlink message for various information
+    /*! Called from \c run() to parse netlink messages and apply them to \c _ifaces
      * \param[in] status message status
      * \param[in] buf message itself */
     void parse_netlink_msg(ssize_t status, struct nlmsghdr* buf);
+    /*! Applies one RTM_NEWADDR/RTM_DELADDR message to \c _ifaces */
+    void parse_addr_msg(struct nlmsghdr* h);
+    /*! Applies one RTM_NEWLINK/RTM_DELLINK message to \c _ifaces and \c _ifnames */
+    void parse_link_msg(struct nlmsghdr* h);
+    /*! Adds or removes one address of interface \c ifname in \c _ifaces.
+     * \param[in] added true for RTM_NEWADDR, false for RTM_DELADDR
+     * \param[in] family AF_INET or AF_INET6
+     * \param[in] addr address in network byte order
+     * \param[in] prefixlen prefix length of the address */
+    void apply_addr_change(bool added, const std::string& ifname, int family, const void* addr, unsigned prefixlen);
+    /*! \return name of the interface, cached in \c _ifnames. */
+    std::optional<std::string> iface_name(int ifindex);
+    /*! Rebuilds \c _ifaces from scratch, used at start and after a netlink overrun (ENOBUFS) */
+    void resync();
+    /*! Prints the added and removed addresses of each changed interface */
+    void print_changes(const std::map<std::string, addrs_diff>& changes);
+    /*! Called from \c run() when the netlink socket is readable. Reads all pending messages.
+     * \param[in] local address the netlink socket is bound to */
+    void read_netlink(const struct sockaddr_nl& local);
+    /*! Called from \c run() when the control socket is readable. Reads all pending requests defined in
+     *  \c sockserver_cmds into \c _pending_update / \c _pending_reload and remembers the senders with
+     *  a bound address in \c _reply_peers. */
+    void read_socket_server();
+    /*! Called from \c run() when \c _event_fd is readable. Moves \c _triggered into the pending flags. */
+    void read_triggers();
+    /*! Called from \c run() after handling the events of one epoll_wait(). Runs each pending action once
+     *  however often it was requested, then replies to \c _reply_peers. */
+    void run_pending();
+    /*! Arms \c _timer_fd to fire after \c _delay unless it is already armed. */
+    void arm_debounce_timer();
     /*! Obtains information about network interfaces using getifaddrs()
-     *  Interfaces with no IP addresses assigned will have 0.0.0.0 and ::
+     *  Interfaces with no IP addresses assigned have empty address lists.
      *  Resets value of \c _ifaces */
     void get_if_addresses();
 };
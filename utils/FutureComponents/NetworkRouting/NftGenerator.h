@@ -1,3 +1,6 @@
+#ifndef NFTGENERATOR_H
+#define NFTGENERATOR_H
+
 #include <vector>
 #include <iostream>
 #include <unordered_map>
@@ -5,62 +8,162 @@
 #include <nftables/libnftables.h>
 #include <jsoncpp/json/json.h>
 #include <sstream>
+#include <string_view>
 #include <sys/un.h>
 #include <sys/socket.h>
 #include <thread>
 #include <map>
 
-/*! Base class for json data structure. */
+/*! Appends JSON text straight into a string buffer, without building a document tree.
+ *  The buffer keeps its capacity across \c clear(), so a reused writer stops allocating
+ *  once it has grown to the size of the largest output. Callers are responsible for
+ *  well-formed nesting; the writer only places commas and escapes strings. */
+class json_writer
+{
+public:
+    //! Drops the written text, keeps the allocated memory
+    void clear() {
+        _buf.clear();
+        _comma = false;
+    }
+    json_writer& begin_object() { separator(); _buf += '{'; _comma = false; return *this; }
+    json_writer& end_object() { _buf += '}'; _comma = true; return *this; }
+    json_writer& begin_array() { separator(); _buf += '['; _comma = false; return *this; }
+    json_writer& end_array() { _buf += ']'; _comma = true; return *this; }
+    //! Cuts the text back to \c size bytes, which must end right after an opening bracket or key
+    void truncate(size_t size) {
+        _buf.resize(size);
+        _comma = false;
+    }
+    //! Writes an object key, the value has to follow
+    json_writer& key(std::string_view k) {
+        separator();
+        string(k);
+        _buf += ':';
+        _comma = false;
+        return *this;
+    }
+    //! Writes a string value
+    json_writer& value(std::string_view v) {
+        separator();
+        string(v);
+        _comma = true;
+        return *this;
+    }
+    //! Writes a key with a string value
+    json_writer& member(std::string_view k, std::string_view v) { return key(k).value(v); }
+    //! \return the written text
+    const std::string& str() const { return _buf; }
+    //! \return the buffer, for appending and removing text that is not a JSON value
+    std::string& buffer() { return _buf; }
+private:
+    void separator() {
+        if (_comma)
+            _buf += ',';
+    }
+    void string(std::string_view s) {
+        static constexpr const char* hex = "0123456789abcdef";
+        _buf += '"';
+        for (char c : s) {
+            switch (c) {
+            case '"':  _buf += "\\\""; break;
+            case '\\': _buf += "\\\\"; break;
+            case '\n': _buf += "\\n"; break;
+            case '\r': _buf += "\\r"; break;
+            case '\t': _buf += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    _buf += "\\u00";
+                    _buf += hex[(c >> 4) & 0xf];
+                    _buf += hex[c & 0xf];
+                } else {
+                    _buf += c;
+                }
+            }
+        }
+        _buf += '"';
+    }
+    std::string _buf;
+    //! Whether the next value needs a comma in front
+    bool _comma = false;
+};
+
+/*! Base class for json data structure: an object with a single key, e.g. {"nftables": ...}
+ *  The value is streamed into \c _writer; \c get_str() closes the text and the next write reopens it. */
 class cmd_json
 {
 public:
     //! Constructs the object
-    cmd_json(std::string keyroot): _keyroot(keyroot) { }
+    cmd_json(std::string keyroot, bool array = false): _closing(array ? "]}" : "}") {
+        _writer.begin_object().key(keyroot);
+        if (array)
+            _writer.begin_array();
+        _prefix_len = _writer.str().size();
+    }
     //! Destructs the object
     virtual ~cmd_json() {}
-    /*! \return stored value as a string */
-    const std::string get_str() {
-        Json::Value root;
-        root[_keyroot] = *_proot;
-        Json::StreamWriterBuilder builder;
-        builder["indentation"] = "";
-        std::ostringstream ss;
-        std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
-        writer->write(root, &ss);
-        return ss.str();
-
+    /*! \return stored value as a string, valid until the next change */
+    const std::string& get_str() {
+        if (!_closed) {
+            _writer.buffer() += _closing;
+            _closed = true;
+        }
+        return _writer.str();
     }
-    /*! \return stored value as a pretty-print string */
+    /*! \return stored value as a pretty-print string. Parses the text, meant for messages only */
     const std::string get_pp() {
-        Json::Value root;
-        root[_keyroot] = *_proot;
-        return root.toStyledString();
+        return get_json().toStyledString();
     }
-    /*! \return stored value as JSON object/array */
+    /*! \return stored value as JSON object/array. Parses the text, meant for messages only */
     const Json::Value get_json() {
         Json::Value root;
-        root[_keyroot] = *_proot;
+        Json::CharReaderBuilder builder;
+        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+        auto& str = get_str();
+        reader->parse(str.data(), str.data() + str.size(), &root, nullptr);
         return root;
     }
+    //! Removes the stored value, keeps the allocated buffer
+    void clear() {
+        _writer.truncate(_prefix_len);
+        _closed = false;
+        _written = false;
+    }
+    //! \return whether no value was written
+    bool empty() const {
+        return !_written;
+    }
 protected:
-    //! Stored commands
-    std::shared_ptr<Json::Value> _proot;
+    //! \return the writer positioned inside the root value
+    json_writer& writer() {
+        if (_closed) {
+            _writer.buffer().resize(_writer.str().size() - _closing.size());
+            _closed = false;
+        }
+        _written = true;
+        return _writer;
+    }
 private:
-    std::string _keyroot;
+    json_writer _writer;
+    //! Text closing the root value
+    std::string _closing;
+    //! Length of the text opening the root value
+    size_t _prefix_len = 0;
+    //! Whether \c _closing is currently appended
+    bool _closed = false;
+    bool _written = false;
 };
 
 class cmd_json_a : public cmd_json
 {
 public:
     //! Constructs the object
-    cmd_json_a(std::string keyroot): cmd_json(keyroot) {
-        _proot = std::make_shared<Json::Value>(Json::Value(Json::arrayValue));
-    }
+    cmd_json_a(std::string keyroot): cmd_json(keyroot, true) { }
     //! Destructs the object
     virtual ~cmd_json_a() {}
-    //! Adds command to the commands list
-    void cmd_append(Json::Value cmd) {
-        _proot->append(cmd);
+    //! \return writer for appending one command (a JSON object) to the commands list
+    json_writer& cmd_writer() {
+        return writer();
     }
 protected:
 private:
@@ -77,6 +180,11 @@ public:
     void test_cmd_append(std::string cmd) {
         test_cmds.emplace_back(cmd);
     }
+    //! Removes all commands including the testing ones, keeps the allocated buffers
+    void clear() {
+        cmd_json_a::clear();
+        test_cmds.clear();
+    }
     //! Stored testing commands
     std::vector<std::string> test_cmds{};
 };
@@ -92,55 +200,54 @@ public:
             std::string type,
             std::vector<std::string>& addresses): nft_root(),
         _family(family), _table(table), _name(name), _type(type), _addresses(addresses)  { }
-    //! \return JSON command creating an empty set
-    Json::Value cmd_add_set_json(bool append = false) {
-        Json::Value set;
-        set["family"] = _family;
-        set["table"] = _table;
-        set["name"] = _name;
-        set["type"] = _type;
-        Json::Value set_root;
-        set_root["set"] = set;
-        Json::Value add;
-        add["add"] = set_root;
-        if (append)
-            _proot->append(add);
-        return add;
-    }
-    //! \return JSON command flushing a set. Prints some errors if set does not exist
-    Json::Value cmd_flush_set_json(bool append = false) {
-        Json::Value set;
-        set["family"] = _family;
-        set["table"] = _table;
-        set["name"] = _name;
-        Json::Value set_root;
-        set_root["set"] = set;
-        Json::Value flush;
-        flush["flush"] = set_root;
-        if (append)
-            _proot->append(flush);
-        return flush;
-    }
-    //! \return JSON command filling the set with elements or creating such set if not exists
-    Json::Value cmd_add_element_json(bool append = false) {
-        Json::Value element;
-        element["family"] = _family;
-        element["table"] = _table;
-        element["name"] = _name;
-        Json::Value ele = Json::arrayValue;
-        for (auto &a : _addresses)
-            ele.append(a);
-        if (ele.empty())
-            ele.append("0.0.0.0");
-        element["elem"] = ele;
-        Json::Value element_root;
-        element_root["element"] = element;
-        Json::Value add;
-        add["add"] = element_root;
-        if (append)
-            _proot->append(add);
-        return add;
+    //! Appends JSON command creating an empty set to \c root
+    void cmd_add_set_json(nft_root& root) {
+        auto& w = root.cmd_writer();
+        w.begin_object().key("add").begin_object().key("set").begin_object();
+        write_id(w);
+        w.member("type", _type);
+        w.end_object().end_object().end_object();
     }
+    //! Appends JSON command creating an empty set to this object
+    void cmd_add_set_json() { cmd_add_set_json(*this); }
+    //! Appends JSON command flushing a set to \c root. Prints some errors if set does not exist
+    void cmd_flush_set_json(nft_root& root) {
+        auto& w = root.cmd_writer();
+        w.begin_object().key("flush").begin_object().key("set").begin_object();
+        write_id(w);
+        w.end_object().end_object().end_object();
+    }
+    //! Appends JSON command flushing a set to this object
+    void cmd_flush_set_json() { cmd_flush_set_json(*this); }
+    //! Appends JSON command filling the set with elements or creating such set if not exists to \c root
+    void cmd_add_element_json(nft_root& root) {
+        if (_addresses.empty())
+            cmd_element_json(root, "add", {"0.0.0.0"});
+        else
+            cmd_element_json(root, "add", _addresses);
+    }
+    //! Appends JSON command filling the set with elements to this object
+    void cmd_add_element_json() { cmd_add_element_json(*this); }
+    /*! Appends JSON command adding the given elements to \c root, other elements of the set are left as they are
+     * \param[in] elements elements to add, must not be empty */
+    void cmd_add_element_json(const std::vector<std::string>& elements, nft_root& root) {
+        cmd_element_json(root, "add", elements);
+    }
+    //! Appends JSON command adding the given elements to this object
+    void cmd_add_element_json(const std::vector<std::string>& elements) { cmd_add_element_json(elements, *this); }
+    /*! Appends JSON command deleting the given elements from the set to \c root
+     * \param[in] elements elements to delete, all of them must be in the set */
+    void cmd_delete_element_json(const std::vector<std::string>& elements, nft_root& root) {
+        cmd_element_json(root, "delete", elements);
+    }
+    //! Appends JSON command deleting the given elements to this object
+    void cmd_delete_element_json(const std::vector<std::string>& elements) { cmd_delete_element_json(elements, *this); }
+    //! \return address family, e.g. \c ip or \c inet
+    const std::string& family() const { return _family; }
+    //! \return table containing the set
+    const std::string& table() const { return _table; }
+    //! \return set name
+    const std::string& name() const { return _name; }
     //! \return BISON command creating an empty set
     const std::string cmd_add_empty() {
         std::stringstream ss;
@@ -163,6 +270,20 @@ public:
         return ss.str();
     }
 private:
+    //! Writes family, table and name identifying the set
+    void write_id(json_writer& w) const {
+        w.member("family", _family).member("table", _table).member("name", _name);
+    }
+    void cmd_element_json(nft_root& root, const char* verb, const std::vector<std::string>& elements) {
+        auto& w = root.cmd_writer();
+        w.begin_object().key(verb).begin_object().key("element").begin_object();
+        write_id(w);
+        w.key("elem").begin_array();
+        for (auto &a : elements)
+            w.value(a);
+        w.end_array();
+        w.end_object().end_object().end_object();
+    }
     //! Address family (contains \c table )
     std::string _family;
     //! Table (contains set \c name )
@@ -174,3 +295,5 @@ private:
     //! Set elements, must not be empty
     std::vector<std::string>& _addresses;
 };
+
+#endif // NFTGENERATOR_H
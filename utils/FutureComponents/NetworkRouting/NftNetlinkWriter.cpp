@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+#include <libmnl/libmnl.h>
+#include <libnftnl/common.h>
+#include <libnftnl/batch.h>
+#include <libnftnl/set.h>
+#include "NftNetlinkWriter.h"
+
+std::optional<uint8_t> nft_family_proto(const std::string& family)
+{
+    if (family == "ip")
+        return NFPROTO_IPV4;
+    if (family == "ip6")
+        return NFPROTO_IPV6;
+    if (family == "inet")
+        return NFPROTO_INET;
+    if (family == "arp")
+        return NFPROTO_ARP;
+    if (family == "bridge")
+        return NFPROTO_BRIDGE;
+    if (family == "netdev")
+        return NFPROTO_NETDEV;
+    return std::nullopt;
+}
+
+nft_netlink_writer::nft_netlink_writer()
+{
+    _nl = mnl_socket_open(NETLINK_NETFILTER);
+    if (_nl == nullptr) {
+        std::cerr << "nft_netlink_writer: mnl_socket_open: " << strerror(errno) << std::endl;
+        return;
+    }
+    if (mnl_socket_bind(_nl, 0, MNL_SOCKET_AUTOPID) < 0) {
+        std::cerr << "nft_netlink_writer: mnl_socket_bind: " << strerror(errno) << std::endl;
+        mnl_socket_close(_nl);
+        _nl = nullptr;
+        return;
+    }
+    _portid = mnl_socket_get_portid(_nl);
+    _seq = static_cast<uint32_t>(time(nullptr));
+    // A lost reply must not block the caller for ever
+    struct timeval tv = { 1, 0 };
+    setsockopt(mnl_socket_get_fd(_nl), SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+nft_netlink_writer::~nft_netlink_writer()
+{
+    if (_nl)
+        mnl_socket_close(_nl);
+}
+
+char* nft_netlink_writer::reserve(size_t size)
+{
+    if (_buf.size() < _len + size)
+        _buf.resize(std::max(_buf.size() * 2, _len + size));
+    memset(_buf.data() + _len, 0, size);
+    return _buf.data() + _len;
+}
+
+void nft_netlink_writer::queue(uint16_t msg_type, const nft_set& set, const uint8_t* keys, size_t key_len, size_t count)
+{
+    if (!_nl || count == 0)
+        return;
+    auto family = nft_family_proto(set.family());
+    if (!family) {
+        std::cerr << "nft_netlink_writer: unknown family " << set.family() << std::endl;
+        return;
+    }
+    std::unique_ptr<struct nftnl_set, void (*)(struct nftnl_set*)> s = { nftnl_set_alloc(), nftnl_set_free };
+    if (!s)
+        return;
+    nftnl_set_set_str(&*s, NFTNL_SET_TABLE, set.table().c_str());
+    nftnl_set_set_str(&*s, NFTNL_SET_NAME, set.name().c_str());
+    for (size_t i = 0; i < count; i++) {
+        auto e = nftnl_set_elem_alloc();
+        if (!e)
+            return;
+        nftnl_set_elem_set(e, NFTNL_SET_ELEM_KEY, keys + i * key_len, key_len);
+        nftnl_set_elem_add(&*s, e);   // owned by the set from now on
+    }
+    if (_len == 0) {
+        _batch_seq = _seq;
+        _len += NLMSG_ALIGN(nftnl_batch_begin(reserve(MNL_NLMSG_HDRLEN + 64), _seq++)->nlmsg_len);
+    }
+    // Header, set and table names plus one nested attribute per element
+    const size_t size = MNL_NLMSG_HDRLEN + 256 + set.table().size() + set.name().size() + count * (key_len + 32);
+    auto nlh = nftnl_nlmsg_build_hdr(reserve(size), msg_type, *family,
+                                     (msg_type == NFT_MSG_NEWSETELEM ? NLM_F_CREATE : 0) | NLM_F_ACK, _seq++);
+    nftnl_set_elems_nlmsg_build_payload(nlh, &*s);
+    _len += NLMSG_ALIGN(nlh->nlmsg_len);
+    _msg_count++;
+}
+
+void nft_netlink_writer::add_elements(const nft_set& set, const std::vector<ip4_prefix>& elements)
+{
+    std::vector<in_addr_t> keys;
+    for (auto& e : elements)
+        keys.push_back(e.addr);
+    queue(NFT_MSG_NEWSETELEM, set, reinterpret_cast<const uint8_t*>(keys.data()), sizeof(in_addr_t), keys.size());
+}
+
+void nft_netlink_writer::add_elements(const nft_set& set, const std::vector<ip6_prefix>& elements)
+{
+    std::vector<struct in6_addr> keys;
+    for (auto& e : elements)
+        keys.push_back(e.addr);
+    queue(NFT_MSG_NEWSETELEM, set, reinterpret_cast<const uint8_t*>(keys.data()), sizeof(struct in6_addr), keys.size());
+}
+
+void nft_netlink_writer::delete_elements(const nft_set& set, const std::vector<ip4_prefix>& elements)
+{
+    std::vector<in_addr_t> keys;
+    for (auto& e : elements)
+        keys.push_back(e.addr);
+    queue(NFT_MSG_DELSETELEM, set, reinterpret_cast<const uint8_t*>(keys.data()), sizeof(in_addr_t), keys.size());
+}
+
+void nft_netlink_writer::delete_elements(const nft_set& set, const std::vector<ip6_prefix>& elements)
+{
+    std::vector<struct in6_addr> keys;
+    for (auto& e : elements)
+        keys.push_back(e.addr);
+    queue(NFT_MSG_DELSETELEM, set, reinterpret_cast<const uint8_t*>(keys.data()), sizeof(struct in6_addr), keys.size());
+}
+
+void nft_netlink_writer::drain()
+{
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    while (recv(mnl_socket_get_fd(_nl), buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+    }
+}
+
+bool nft_netlink_writer::commit()
+{
+    if (_msg_count == 0)
+        return true;
+    size_t pending = _msg_count;
+    _msg_count = 0;
+    const uint32_t end_seq = _seq;
+    _len += NLMSG_ALIGN(nftnl_batch_end(reserve(MNL_NLMSG_HDRLEN + 64), _seq++)->nlmsg_len);
+    const size_t len = _len;
+    _len = 0;
+    // Acks of a batch that timed out must not be counted for this one
+    drain();
+    if (mnl_socket_sendto(_nl, _buf.data(), len) < 0) {
+        std::cerr << "nft_netlink_writer: mnl_socket_sendto: " << strerror(errno) << std::endl;
+        return false;
+    }
+    // Every element message carries NLM_F_ACK, so each gets an ack or an error;
+    // on any error the kernel aborts the whole transaction
+    bool committed = true;
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    while (pending > 0) {
+        auto ret = mnl_socket_recvfrom(_nl, buf, sizeof(buf));
+        if (ret < 0) {
+            std::cerr << "nft_netlink_writer: mnl_socket_recvfrom: " << strerror(errno) << std::endl;
+            return false;
+        }
+        int remaining = static_cast<int>(ret);
+        for (auto nlh = reinterpret_cast<const struct nlmsghdr*>(buf); mnl_nlmsg_ok(nlh, remaining);
+             nlh = mnl_nlmsg_next(nlh, &remaining)) {
+            // Unsigned distance, correct when the sequence numbers wrap within the batch
+            const uint32_t offset = nlh->nlmsg_seq - _batch_seq;
+            if (nlh->nlmsg_type != NLMSG_ERROR || offset > end_seq - _batch_seq)
+                continue;
+            auto err = static_cast<const struct nlmsgerr*>(mnl_nlmsg_get_payload(nlh));
+            if (err->error != 0) {
+                std::cerr << "nft_netlink_writer: " << strerror(-err->error) << std::endl;
+                committed = false;
+            }
+            if (offset == 0 || offset == end_seq - _batch_seq) {
+                // BEGIN or END rejected, no element message is processed or acknowledged
+                if (err->error != 0)
+                    pending = 0;
+                continue;
+            }
+            if (pending > 0)
+                pending--;
+        }
+    }
+    return committed;
+}
@@ -0,0 +1,75 @@
+#ifndef NFTNETLINKWRITER_H
+#define NFTNETLINKWRITER_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "IpAddress.h"
+#include "NftGenerator.h"
+
+struct mnl_socket;
+
+/*! \return netfilter protocol family (NFPROTO_*) of an nft family name, e.g. \c inet */
+std::optional<uint8_t> nft_family_proto(const std::string& family);
+
+/*! Writes set element changes straight to the kernel as a nf_tables netlink batch.
+ *  Messages are built with libnftnl and sent over one libmnl socket, so no nft text
+ *  or JSON has to be generated and parsed. Sets must already exist; creating them is
+ *  left to libnftables. All changes queued until \c commit() form one transaction. */
+class nft_netlink_writer
+{
+public:
+    //! Opens the NETLINK_NETFILTER socket, check \c ok() afterwards
+    nft_netlink_writer();
+    //! Closes the socket
+    ~nft_netlink_writer();
+    nft_netlink_writer(const nft_netlink_writer&) = delete;
+    nft_netlink_writer& operator=(const nft_netlink_writer&) = delete;
+    //! \return whether the socket could be opened and bound
+    bool ok() const { return _nl != nullptr; }
+    /*! Queues adding elements to a set
+     * \param[in] set family, table and name of the set
+     * \param[in] elements addresses to add, the prefix length is ignored */
+    void add_elements(const nft_set& set, const std::vector<ip4_prefix>& elements);
+    //! \overload
+    void add_elements(const nft_set& set, const std::vector<ip6_prefix>& elements);
+    /*! Queues deleting elements from a set
+     * \param[in] set family, table and name of the set
+     * \param[in] elements addresses to delete, the prefix length is ignored */
+    void delete_elements(const nft_set& set, const std::vector<ip4_prefix>& elements);
+    //! \overload
+    void delete_elements(const nft_set& set, const std::vector<ip6_prefix>& elements);
+    //! \return whether anything is queued
+    bool empty() const { return _msg_count == 0; }
+    /*! Sends all queued changes as one batch and waits for the kernel to acknowledge them.
+     *  The queue is emptied in any case.
+     * \return true if the kernel committed the batch */
+    bool commit();
+private:
+    /*! Appends one NEWSETELEM/DELSETELEM message to the batch
+     * \param[in] keys element keys, \c key_len bytes each, in network byte order */
+    void queue(uint16_t msg_type, const nft_set& set, const uint8_t* keys, size_t key_len, size_t count);
+    /*! Makes room for a message of at most \c size bytes at the end of the batch
+     * \return where to build it */
+    char* reserve(size_t size);
+    //! Netlink socket, nullptr if it could not be opened
+    mnl_socket* _nl = nullptr;
+    //! Port id of \c _nl, to match the replies
+    uint32_t _portid = 0;
+    //! Sequence number of the next message
+    uint32_t _seq = 0;
+    //! Sequence number of the BEGIN message of the queued batch; replies outside the batch are stale
+    uint32_t _batch_seq = 0;
+    //! Queued messages, starting with the batch BEGIN message once anything is queued
+    std::vector<char> _buf;
+    //! Bytes of \c _buf in use
+    size_t _len = 0;
+    //! Number of element messages in \c _buf, each of them is acknowledged
+    size_t _msg_count = 0;
+    //! Discards replies left in the socket by an earlier commit() that timed out
+    void drain();
+};
+
+#endif // NFTNETLINKWRITER_H
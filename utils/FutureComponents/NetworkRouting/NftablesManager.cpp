@@ -1,7 +1,21 @@
 #include "NftablesManager.h"
+#include "Logger.h"
 
 NftablesManager::NftablesManager(QObject *parent) : QObject(parent)
 {
+    _nft.reset(nft_ctx_new(NFT_CTX_DEFAULT));
+    if (!_nft) {
+        Logger("Failed to obtain nftables context.");
+        return;
+    }
+    // Commands are JSON documents; text ones still parse, libnftables falls back to its text parser
+    nft_ctx_input_set_flags(_nft.get(), NFT_CTX_INPUT_JSON);
+    nft_ctx_output_set_flags(_nft.get(), NFT_CTX_OUTPUT_JSON);
+    // Keep error messages for the log instead of letting libnftables print them
+    nft_ctx_buffer_error(_nft.get());
+    _nl_writer = std::make_unique<nft_netlink_writer>();
+    if (!_nl_writer->ok())
+        _nl_writer.reset();
 }
 
 void NftablesManager::help()
@@ -59,15 +73,27 @@ void NftablesManager::addIpToBlacklist(QString ip)
 void NftablesManager::removeIpFromBlacklist(QString ip)
 {
     // Assuming the blacklist is stored in a set named "blacklist" in the "filter" table of the "ip" family
-    // Remove the rule by flushing the set and then re-adding all elements except the one to be removed
-    // TODO: Implement this functionality
+    std::vector<std::string> none;
+    nft_set blacklist("ip", "filter", "blacklist", "ipv4_addr", none);
+    blacklist.cmd_delete_element_json({ip.toStdString()});
+    runNftCommand(QString::fromStdString(blacklist.get_str()));
 }
 
-void NftablesManager::runNftCommand(QString command)
+void NftablesManager::updateInterfaces(const ifaces_map& ifaces)
 {
-    QProcess process;
-    process.start("nft", QStringList() << command);
-    process.waitForFinished();
+    _ifaces = copy_ifaces(ifaces);
+    update_conf();
+}
+
+bool NftablesManager::runNftCommand(QString command)
+{
+    if (!_nft)
+        return false;
+    if (nft_run_cmd_from_buffer(_nft.get(), command.toStdString().c_str()) != 0) {
+        Logger("Error running nft command: " + command.toStdString() + " : " + nft_ctx_get_error_buffer(_nft.get()));
+        return false;
+    }
+    return true;
 }
 
 std::vector<std::string> NftablesManager::convertQStringListToStd(QStringList list)
@@ -100,45 +126,131 @@ std::optional<std::string> NftablesManager::atomic_write(const std::string& path
     return std::nullopt;
 }
 
+std::vector<nft_set> NftablesManager::iface_sets(const std::string& ifname, std::vector<std::string>& addresses)
+{
+    std::vector<nft_set> sets;
+    std::string set_4a = ifname + "_ipv4_address";
+    sets.emplace_back("ip", "nat", set_4a, "ipv4_addr", addresses);
+    sets.emplace_back("inet", "filter", set_4a, "ipv4_addr", addresses);
+    return sets;
+}
+
+std::vector<ip4_prefix> NftablesManager::set_elements(const struct addrs* a)
+{
+    std::vector<ip4_prefix> elements;
+    if (a) {
+        // ipv4_addr sets hold plain addresses, the prefix length is not part of the element
+        for (auto& addr : a->ipv4)
+            elements.push_back({addr.addr, 32});
+        std::sort(elements.begin(), elements.end());
+        elements.erase(std::unique(elements.begin(), elements.end()), elements.end());
+    }
+    if (elements.empty())
+        elements.push_back({0, 32});
+    return elements;
+}
+
 std::shared_ptr<nft_root> NftablesManager::create_sets_ifaces()
 {
-    nft_root cmd_json_nft;
+    auto& cmd_json_nft = *_cmds;
+    cmd_json_nft.clear();
     for (auto p = _ifaces.begin(); p != _ifaces.end(); p++)
     {
-        std::vector<nft_set> sets;
-        std::string set_4a = p->first + "_ipv4_address";
-        sets.emplace_back("ip", "nat", set_4a, "ipv4_addr", p->second->ipv4);
-        sets.emplace_back("inet", "filter", set_4a, "ipv4_addr", p->second->ipv4);
+        auto ipv4 = addr_strings(p->second->ipv4);
+        auto sets = iface_sets(p->first, ipv4);
         for (auto& ns : sets) {
-            cmd_json_nft.cmd_append(ns.cmd_add_set_json());
-            cmd_json_nft.cmd_append(ns.cmd_flush_set_json());
-            cmd_json_nft.cmd_append(ns.cmd_add_element_json());
+            ns.cmd_add_set_json(cmd_json_nft);
+            ns.cmd_flush_set_json(cmd_json_nft);
+            ns.cmd_add_element_json(cmd_json_nft);
             cmd_json_nft.test_cmd_append(ns.cmd_add_empty());
         }
     }
-    return std::make_shared<nft_root>(cmd_json_nft);
+    return _cmds;
+}
+
+addr_diff<ip4_prefix> NftablesManager::set_elements_diff(const std::string& ifname)
+{
+    auto now = _ifaces.find(ifname);
+    auto before = _applied.find(ifname);
+    return diff_sorted(set_elements(before != _applied.end() ? before->second.get() : nullptr),
+                       set_elements(now != _ifaces.end() ? now->second.get() : nullptr));
+}
+
+bool NftablesManager::netlink_update()
+{
+    auto changes = diff_ifaces(_applied, _ifaces);
+    for (auto& [ifname, d] : changes)
+        if (d.iface_added)
+            return runtime_update(create_sets_delta());
+    for (auto& [ifname, d] : changes) {
+        auto elements = set_elements_diff(ifname);
+        std::vector<std::string> none;
+        for (auto& ns : iface_sets(ifname, none)) {
+            _nl_writer->delete_elements(ns, elements.removed);
+            _nl_writer->add_elements(ns, elements.added);
+        }
+    }
+    return _nl_writer->commit();
+}
+
+std::shared_ptr<nft_root> NftablesManager::create_sets_delta()
+{
+    auto cmd_json_nft = _cmds;
+    cmd_json_nft->clear();
+    for (auto& [ifname, d] : diff_ifaces(_applied, _ifaces))
+    {
+        std::vector<std::string> none;
+        auto sets = iface_sets(ifname, none);
+        if (d.iface_added) {
+            // Never written by this manager, so its current content is unknown
+            auto now = _ifaces.find(ifname);
+            auto all = addr_strings(set_elements(now != _ifaces.end() ? now->second.get() : nullptr));
+            for (auto& ns : sets) {
+                ns.cmd_add_set_json(*cmd_json_nft);
+                ns.cmd_flush_set_json(*cmd_json_nft);
+                ns.cmd_add_element_json(all, *cmd_json_nft);
+                cmd_json_nft->test_cmd_append(ns.cmd_add_empty());
+            }
+            continue;
+        }
+        auto elements = set_elements_diff(ifname);
+        if (elements.empty())
+            continue;   // e.g. only IPv6 or the prefix length changed
+        auto added = addr_strings(elements.added);
+        auto removed = addr_strings(elements.removed);
+        for (auto& ns : sets) {
+            if (!removed.empty())
+                ns.cmd_delete_element_json(removed, *cmd_json_nft);
+            if (!added.empty())
+                ns.cmd_add_element_json(added, *cmd_json_nft);
+        }
+    }
+    return cmd_json_nft;
 }
 
 bool NftablesManager::runtime_update(std::shared_ptr<nft_root> cmd_json_nft)
 {
-    std::unique_ptr<struct nft_ctx, void (*)(struct nft_ctx*)> nft = { nft_ctx_new(NFT_CTX_DEFAULT), nft_ctx_free };
-    nft_ctx_output_set_flags(&*nft, NFT_CTX_OUTPUT_JSON);
-    if (!nft) {
+    if (!_nft) {
         Logger("Failed to obtain nftables context.");
-        return;
+        return false;
     }
-    // need to test that set can be added to table (permissions, table exists etc.)
-    nft_ctx_set_dry_run(&*nft, true);
+    if (cmd_json_nft->empty())
+        return true;
     bool cmd_ok = true;
-    for (auto& cmd : cmd_json_nft->test_cmds) {
-        if (nft_run_cmd_from_buffer(&*nft, cmd.c_str()) != 0)
-            cmd_ok = false;
+    if (!cmd_json_nft->test_cmds.empty()) {
+        // need to test that set can be added to table (permissions, table exists etc.)
+        nft_ctx_set_dry_run(_nft.get(), true);
+        for (auto& cmd : cmd_json_nft->test_cmds) {
+            if (nft_run_cmd_from_buffer(_nft.get(), cmd.c_str()) != 0)
+                cmd_ok = false;
+        }
+        nft_ctx_set_dry_run(_nft.get(), false);
+    }
+    // All commands of one JSON document are committed as a single transaction
+    if (cmd_ok && nft_run_cmd_from_buffer(_nft.get(), cmd_json_nft->get_str().c_str()) != 0) {
+        Logger("Error running nft command: " + cmd_json_nft->get_pp() + " : " + nft_ctx_get_error_buffer(_nft.get()));
+        cmd_ok = false;
     }
-    nft_ctx_set_dry_run(&*nft, false);
-    if (cmd_ok)
-        if (nft_run_cmd_from_buffer(&*nft, cmd_json_nft->get_pp().c_str()) != 0)
-            Logger("Error running nft command: " + cmd_json_nft->get_pp() + " : ");
-    //std::cout << cmd_json_nft->get_pp().c_str() << std::endl;
     return cmd_ok;
 }
 
@@ -153,7 +265,7 @@ void NftablesManager::ifaces_filewrite_sets_vars()
         // prepare update file with constant definitions (unnamed vars)
         filecontent_vars << "redefine " << p->first << "_ipv4_address  = { ";
         for (auto &addr : p->second->ipv4)
-            filecontent_vars << addr << ", ";
+            filecontent_vars << addr.addr_str() << ", ";
         if (p->second->ipv4.empty())
             filecontent_vars << "0.0.0.0";
         filecontent_vars << " }\n";
@@ -161,7 +273,7 @@ void NftablesManager::ifaces_filewrite_sets_vars()
         // IPv4 network addresses  (unnamed vars)
         filecontent_vars << "redefine " << p->first << "_ipv4_network  = { ";
         for (auto &addr : p->second->ipv4_net)
-            filecontent_vars << addr << ", ";
+            filecontent_vars << addr.cidr_str() << ", ";
         if (p->second->ipv4_net.empty())
             filecontent_vars << "0.0.0.0";
         filecontent_vars << " }\n";
@@ -169,7 +281,7 @@ void NftablesManager::ifaces_filewrite_sets_vars()
         // prepare update file with named sets
         filecontent_sets << "set " << p->first << "_ipv4_address { type ipv4_addr; elements = { ";
         for (auto &addr : p->second->ipv4)
-            filecontent_sets << addr << ", ";
+            filecontent_sets << addr.addr_str() << ", ";
         if (p->second->ipv4.empty())
             filecontent_sets << "0.0.0.0";
         filecontent_sets << " } }\n";
@@ -177,7 +289,7 @@ void NftablesManager::ifaces_filewrite_sets_vars()
         // IPv4 network addresses (named sets)
         filecontent_sets << "set " << p->first << "_ipv4_network { type ipv4_addr; elements = { ";
         for (auto &addr : p->second->ipv4_net)
-            filecontent_sets << addr << ", ";
+            filecontent_sets << addr.cidr_str() << ", ";
         if (p->second->ipv4_net.empty())
             filecontent_sets << "0.0.0.0";
         filecontent_sets << " } }\n";
@@ -200,24 +312,34 @@ void NftablesManager::update_conf()
     // Always write up-to-date values into file, no matter if updating running conf or reflushing from file
     ifaces_filewrite_sets_vars();
     if (_opt_flush || _opt_start) {
-        std::unique_ptr<struct nft_ctx, void (*)(struct nft_ctx*)> nft = { nft_ctx_new(NFT_CTX_DEFAULT), nft_ctx_free };
-        if (!nft) {
+        if (!_nft) {
             Logger("Failed to obtain nftables context.");
             return;
         }
-        nft_run_cmd_from_filename(&*nft, nft_conf_file());
+        // The reloaded ruleset includes the file written above, so it matches _ifaces
+        if (nft_run_cmd_from_filename(_nft.get(), nft_conf_file()) == 0)
+            _applied = copy_ifaces(_ifaces);
+        else
+            _applied.clear();
     } else {
-        runtime_update(create_sets_ifaces());
+        // Only the changed elements while the running sets are known, all of them otherwise
+        bool ok = !_applied.empty() && (_nl_writer ? netlink_update() : runtime_update(create_sets_delta()));
+        if (!ok)
+            ok = runtime_update(create_sets_ifaces());
+        if (ok)
+            _applied = copy_ifaces(_ifaces);
+        else
+            _applied.clear();
     }
 }
 
 void NftablesManager::rm_nft_sets ()
 {
-    std::unique_ptr<struct nft_ctx, void (*)(struct nft_ctx*)> nft = { nft_ctx_new(NFT_CTX_DEFAULT), nft_ctx_free };
-    if (!nft)
+    if (!_nft)
         return;
     for (auto p = _ifaces.begin(); p != _ifaces.end(); p++) {
-        nft_run_cmd_from_buffer(&*nft, ("delete set ip nat " + p->first).c_str());
-        nft_run_cmd_from_buffer(&*nft, ("delete set inet filter " + p->first).c_str());
+        nft_run_cmd_from_buffer(_nft.get(), ("delete set ip nat " + p->first).c_str());
+        nft_run_cmd_from_buffer(_nft.get(), ("delete set inet filter " + p->first).c_str());
     }
+    _applied.clear();
 }
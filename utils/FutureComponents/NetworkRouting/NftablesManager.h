@@ -3,7 +3,6 @@
 
 #include <QObject>
 #include <QString>
-#include <QProcess>
 #include <optional>
 #include <vector>
 #include <iostream>
@@ -11,6 +10,7 @@
 #include <memory>
 #include <jsoncpp/json/json.h>
 #include "NftGenerator.h"
+#include "NftNetlinkWriter.h"
 #include "IpInterfacesManager.h"
 
 
@@ -19,6 +19,7 @@ class NftablesManager : public QObject
     Q_OBJECT
 
 public:
+    /*! Creates the libnftables context used for every command of this manager */
     explicit NftablesManager(QObject *parent = nullptr);
     virtual ~NftablesManager() = default;
 
@@ -28,18 +29,44 @@ public slots:
     void addIpToBlacklist(QString ip);
     void removeIpFromBlacklist(QString ip);
     void help();
+    /*! Replaces the stored interface addresses and brings nftables up to date with them */
+    void updateInterfaces(const ifaces_map& ifaces);
 private:
     //! Stored interface names and addresses
-    std::unordered_map<std::string, std::shared_ptr<struct addrs>> _ifaces;
-    void runNftCommand(QString command);
+    ifaces_map _ifaces;
+    //! Interface addresses as last written into the running nftables sets, empty if unknown
+    ifaces_map _applied;
+    //! libnftables context, kept for the lifetime of the manager
+    std::unique_ptr<struct nft_ctx, void (*)(struct nft_ctx*)> _nft{nullptr, nft_ctx_free};
+    //! Commands of the current update, cleared and refilled for every update to reuse its buffer
+    std::shared_ptr<nft_root> _cmds = std::make_shared<nft_root>();
+    //! Netlink batch writer for element changes of existing sets, nullptr if not available
+    std::unique_ptr<nft_netlink_writer> _nl_writer;
+    /*! Runs one command in-process through libnftables
+     * \return true on success */
+    bool runNftCommand(QString command);
     /*! Updates nftables IP addresses files \ref nft_outfile_sets() and \ref nft_outfile_vars. */
     void ifaces_filewrite_sets_vars();
     /*! Creates ip nat and inet filter sets for each interface in \ref _ifaces. */
     std::shared_ptr<nft_root>  create_sets_ifaces();
-    /*! Updates nftables runtime configuration */
+    /*! Adds and deletes only the set elements that differ between \ref _applied and \ref _ifaces.
+     *  Sets of interfaces missing from \ref _applied are created and filled completely. */
+    std::shared_ptr<nft_root>  create_sets_delta();
+    /*! Writes the element changes between \ref _applied and \ref _ifaces through \ref _nl_writer.
+     *  Falls back to \ref create_sets_delta() when sets of new interfaces have to be created.
+     * \return true if the changes were committed */
+    bool netlink_update();
+    //! \return set elements to delete and add for interface \c ifname, from \ref _applied to \ref _ifaces
+    addr_diff<ip4_prefix> set_elements_diff(const std::string& ifname);
+    //! \return ip nat and inet filter sets holding IPv4 addresses of interface \c ifname
+    static std::vector<nft_set> iface_sets(const std::string& ifname, std::vector<std::string>& addresses);
+    /*! \return sorted elements of an interface address set, the 0.0.0.0 placeholder for no address */
+    static std::vector<ip4_prefix> set_elements(const struct addrs* a);
+    /*! Updates nftables runtime configuration in a single transaction
+     * \return true if the transaction was committed */
     bool runtime_update(std::shared_ptr<nft_root> cmd_json_nft);
     /*! Updates nftables configuration and configuration file with information in \c _ifaces
-     *  Running configuration is updated by reseting named set values (accesed with @set)
+     *  Running configuration is updated by adding and deleting changed named set elements (accesed with @set)
      *  Persistent configuration is updated by overwriting file at \c nft_outfile_sets() and \c nft_outfile_vars()
      *  where values are put into variables (accesed with $variable) or sets (accesed with @set).
      *  Persistent configuration is reloaded on program start if \c _opt_start is set and if \c _opt_flush is set then